@@ -7,11 +7,19 @@ set(SRC
   "${SRC_PATH}/PointerHashMap.cpp"
   "${SRC_PATH}/SmallAlloc.cpp"
   "${SRC_PATH}/Heap.cpp"
+  "${SRC_PATH}/Arena.cpp"
+  "${SRC_PATH}/SharedHeap.cpp"
+  "${SRC_PATH}/PersistentHeap.cpp"
   "${SRC_PATH}/BuddyManager.cpp"
   "${SRC_PATH}/SlabAllocator.cpp"
   "${SRC_PATH}/rpmalloc/rpmalloc.c"
 )
 
+# Set opt-in global operator new/delete replacement files.
+set(NEW_DELETE_SRC
+  "${SRC_PATH}/NewDelete.cpp"
+)
+
 # Set project main file.
 set(MAIN_SRC
   "${SRC_PATH}/benchmark.cpp"
@@ -24,4 +32,12 @@ set(TEST_SRC
   "${TEST_SRC_PATH}/testBuddyManager.cpp"
   "${TEST_SRC_PATH}/testSlabAllocator.cpp"
   "${TEST_SRC_PATH}/testHeap.cpp"
+  "${TEST_SRC_PATH}/testAllocator.cpp"
+  "${TEST_SRC_PATH}/testSharedHeap.cpp"
+)
+
+# Set test source files linked against the global operator new/delete replacement.
+set(NEW_DELETE_TEST_SRC
+  "${TEST_SRC_PATH}/testBase.cpp"
+  "${TEST_SRC_PATH}/testNewDelete.cpp"
 )
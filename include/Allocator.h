@@ -0,0 +1,112 @@
+/**
+ * File: /Allocator.h
+ * Project: include
+ * Created Date: Monday, October 19th 2026, 2:05:10 pm
+ * Author: Harikrishnan
+ */
+
+
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include "Heap.h"
+
+#include <memory_resource>
+#include <new>
+
+namespace SmallAlloc
+{
+
+inline void *heap_alloc(Heap &heap, size_t size, size_t align)
+{
+	auto ptr = align <= MIN_ALIGNMENT ? heap.alloc(size) : heap.alloc_aligned(size, align);
+
+	if (!ptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+inline void heap_free(Heap &heap, void *ptr, size_t size, size_t align)
+{
+	if (align <= MIN_ALIGNMENT)
+		heap.free(ptr, size);
+	else
+		heap.free_aligned(ptr, size, align);
+}
+
+class MemoryResource : public std::pmr::memory_resource
+{
+public:
+	explicit MemoryResource(Heap &heap) : m_heap(heap)
+	{}
+
+private:
+	Heap &m_heap;
+
+	void *do_allocate(size_t bytes, size_t alignment) override
+	{
+		return heap_alloc(m_heap, bytes ? bytes : 1, alignment);
+	}
+
+	void do_deallocate(void *ptr, size_t bytes, size_t alignment) override
+	{
+		heap_free(m_heap, ptr, bytes ? bytes : 1, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+	{
+		auto other_resource = dynamic_cast<const MemoryResource *>(&other);
+		return other_resource && &other_resource->m_heap == &m_heap;
+	}
+};
+
+// Allocates from the calling thread's heap. Memory goes back to the heap that owns it, so a
+// container may be destroyed on any thread.
+template <typename T>
+class Allocator
+{
+public:
+	using value_type = T;
+
+	Allocator() = default;
+
+	template <typename U>
+	Allocator(const Allocator<U> &)
+	{}
+
+	T *allocate(size_t count)
+	{
+		if (count > SIZE_MAX / sizeof(T))
+			throw std::bad_alloc();
+
+		return static_cast<T *>(heap_alloc(Heap::thread_heap(), alloc_size(count), alignof(T)));
+	}
+
+	void deallocate(T *ptr, size_t count)
+	{
+		Heap::free_global(ptr, alloc_size(count), alignof(T));
+	}
+
+	template <typename U>
+	bool operator==(const Allocator<U> &) const
+	{
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const Allocator<U> &) const
+	{
+		return false;
+	}
+
+private:
+	static size_t alloc_size(size_t count)
+	{
+		return count ? count * sizeof(T) : 1;
+	}
+};
+
+}
+
+#endif /* ALLOCATOR_H */
@@ -0,0 +1,81 @@
+/**
+ * File: /Arena.h
+ * Project: include
+ * Created Date: Monday, October 19th 2026, 7:24:05 pm
+ * Author: Harikrishnan
+ */
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "Heap.h"
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace SmallAlloc
+{
+
+// Bump allocates out of large blocks taken from a parent heap and releases everything at once in
+// reset(). Requests too big for a block are served by the parent heap and released with it.
+class Arena
+{
+public:
+	static constexpr size_t DEFAULT_ALIGNMENT = 16;
+	static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+	explicit Arena(Heap &parent = Heap::thread_heap(), size_t initial_block_size = MIN_BLOCK_SIZE);
+	~Arena();
+
+	Arena(const Arena &arena_rhs) = delete;
+	Arena &operator=(const Arena &arena_rhs) = delete;
+
+	inline void *alloc(size_t size, size_t align = DEFAULT_ALIGNMENT);
+	void reset();
+	size_t size();
+
+	template <typename T, typename... Args>
+	T *make(Args &&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+
+		auto ptr = alloc(sizeof(T), alignof(T));
+		return ptr ? new (ptr) T(std::forward<Args>(args)...) : nullptr;
+	}
+
+private:
+	struct Block;
+	struct LargeAlloc;
+
+	Heap &m_parent;
+	char *m_cur = nullptr;
+	char *m_end = nullptr;
+	Block *m_blocks = nullptr;
+	LargeAlloc *m_large = nullptr;
+	const size_t m_initial_block_size;
+	size_t m_next_block_size;
+	size_t m_size = 0;
+
+	void *alloc_slow(size_t size, size_t align);
+	void *alloc_large(size_t size, size_t align);
+};
+
+inline void *Arena::alloc(size_t size, size_t align)
+{
+	auto addr = (reinterpret_cast<uintptr_t>(m_cur) + align - 1) & ~(align - 1);
+	auto end = reinterpret_cast<uintptr_t>(m_end);
+
+	if (addr < end && size <= end - addr)
+	{
+		m_cur = reinterpret_cast<char *>(addr + size);
+		return reinterpret_cast<void *>(addr);
+	}
+
+	return alloc_slow(size, align);
+}
+
+}
+
+#endif /* ARENA_H */
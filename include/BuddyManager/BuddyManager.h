@@ -27,22 +27,26 @@ class BuddyManager
 {
 public:
 	BuddyManager(Size alloc_limit, std::function<void *(Size, Size)> aligned_alloc_chunk,
-				 std::function<void (void *, Size)> free_chunk);
+				 std::function<void (void *, Size)> free_chunk, bool zeroed_chunks = false);
 	~BuddyManager();
 
 	BuddyManager(const BuddyManager &bm) = delete;
 	BuddyManager(BuddyManager &&bm) = delete;
 
-	void *alloc(Size size);
+	void *alloc(Size size, bool *is_zeroed = nullptr);
 	void free(void *ptr, Size size);
+	bool resize(void *ptr, Size old_size, Size new_size);
+	void reset(bool retain_chunks = true);
+	bool reserve(Size size);
+	void set_retain_chunks(bool retain_chunks);
 	Size size();
 
-	constexpr auto get_min_alloc_size()
+	constexpr static auto get_min_alloc_size()
 	{
 		return BuddyMinAllocSize;
 	}
 
-	constexpr auto get_page_size()
+	constexpr static auto get_page_size()
 	{
 		return BuddyPageSize;
 	}
@@ -58,6 +62,7 @@ private:
 	{
 		BMMeta meta;
 		void *m_managed_chunk;
+		uint8_t m_dirty[BuddyPageSize / BuddyMinAllocSize / 8];
 
 		BMMetaNode() = default;
 		~BMMetaNode() = default;
@@ -79,7 +84,9 @@ private:
 	void mark_block_as_free(BMMetaNode *meta, BuddyFreeNode *ptr, SizeClass szc);
 	void mark_block_as_in_use(BMMetaNode *meta, BuddyFreeNode *ptr, SizeClass szc);
 	bool block_is_free(BMMetaNode *meta, BuddyFreeNode *ptr, SizeClass szc) const;
+	bool mark_block_as_dirty(BMMetaNode *meta, BuddyFreeNode *ptr, Size size);
 
+	BMMetaNode *get_chunk_meta(void *ptr);
 	BMMetaNode *alloc_chunk();
 	void free_chunk(BMMetaNode *meta);
 
@@ -88,7 +95,10 @@ private:
 	BuddyFreeList m_freelist[BMMeta::get_num_sizeclasses_const()];
 	Size m_alloc_limit;
 	Size m_chunk_count;
+	Size m_min_chunk_count;
 	Count m_num_class_sizes;
+	bool m_zeroed_chunks;
+	bool m_retain_chunks;
 	SmallAlloc::utility::PointerHashMap m_chunk_meta_map;
 };
 
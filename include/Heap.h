@@ -1,6 +1,10 @@
 #ifndef HEAP_H
 #define HEAP_H
 
+#include "SlabAllocator.h"
+#include "SlabSizeClass.h"
+
+#include <iterator>
 #include <memory>
 
 namespace SmallAlloc
@@ -9,21 +13,104 @@ namespace SmallAlloc
 class Heap
 {
 public:
-	explicit Heap(size_t alloc_limit = 0);
+	// Locks every chunk and huge mapping into memory as it is mapped. Chunks are never handed back
+	// to the system, not even by reset(false); huge mappings are still unmapped when freed.
+	static constexpr unsigned LOCKED = 0x1;
+
+	explicit Heap(size_t alloc_limit = 0, unsigned flags = 0);
+	// Serves every allocation from the buddy page sized, naturally aligned chunks inside
+	// [memory, memory + size); allocations larger than a chunk fail. A null memory gives a heap
+	// that fails every allocation.
+	Heap(void *memory, size_t size, unsigned flags = 0);
 	~Heap();
 
 	Heap(const Heap &heap_rhs) = delete;
 	Heap(Heap &&heap_rhs);
 
-	void *alloc(size_t size);
-	void free(void *ptr, size_t ptr_size);
+	inline void *alloc(size_t size);
+	inline void free(void *ptr, size_t ptr_size);
+	inline void *alloc_sizeclass(SizeClass szc);
+	inline void free_sizeclass(void *ptr, SizeClass szc);
+	void *calloc(size_t count, size_t size);
+	// Resizing to 0 frees ptr and returns nullptr.
+	void *realloc(void *ptr, size_t old_size, size_t new_size);
+	// Frees from other threads are batched per thread until flush_remote(); batches still held for a
+	// heap when it is destroyed or reset are dropped. Blocks above the slab sizes skip the batches.
 	void remote_free(void *ptr, size_t ptr_size);
+
+	// Takes any power of two alignment; on Windows allocations larger than a chunk are aligned to
+	// 64K at most.
+	void *alloc_aligned(size_t size, size_t align);
+	void free_aligned(void *ptr, size_t ptr_size, size_t align);
+
+	void *alloc_cacheline(size_t size);
+	void free_cacheline(void *ptr, size_t ptr_size);
+	void remote_free_cacheline(void *ptr, size_t ptr_size);
+
 	size_t size();
+	void reset(bool retain_chunks = true);
+	bool reserve(size_t size, size_t count, bool prefault = true);
+	bool reserve_bytes(size_t size, bool prefault = true);
+
+	static void flush_remote();
+	static Heap &thread_heap();
+	static void free_global(void *ptr);
+	static void free_global(void *ptr, size_t ptr_size, size_t align = 1);
 
 private:
+	static constexpr size_t MAX_SMALL_SIZE = std::size(size_to_sizeclass);
+
 	class HeapImpl;
+	class RemoteFreeCache;
 	std::unique_ptr<HeapImpl> impl;
+	// Null until the class's slab is constructed.
+	SlabAllocator::SlabAllocator **m_slab;
+
+	void *alloc_slow(size_t size);
+	void free_slow(void *ptr, size_t ptr_size);
+	void *alloc_sizeclass_slow(SizeClass szc);
+	void free_sizeclass_slow(void *ptr, SizeClass szc);
+
+	static RemoteFreeCache &remote_free_cache();
 };
 
+inline void *Heap::alloc(size_t size)
+{
+	if (size <= MAX_SMALL_SIZE)
+	{
+		auto slab = m_slab[size_to_sizeclass[size - 1]];
+		auto ptr = slab ? slab->try_alloc_fast() : nullptr;
+
+		if (ptr)
+			return ptr;
+	}
+
+	return alloc_slow(size);
+}
+
+inline void Heap::free(void *ptr, size_t ptr_size)
+{
+	auto slab = ptr_size <= MAX_SMALL_SIZE ? m_slab[size_to_sizeclass[ptr_size - 1]] : nullptr;
+
+	if (!slab || !slab->try_free_fast(ptr))
+		free_slow(ptr, ptr_size);
+}
+
+inline void *Heap::alloc_sizeclass(SizeClass szc)
+{
+	auto slab = m_slab[szc];
+	auto ptr = slab ? slab->try_alloc_fast() : nullptr;
+
+	return ptr ? ptr : alloc_sizeclass_slow(szc);
+}
+
+inline void Heap::free_sizeclass(void *ptr, SizeClass szc)
+{
+	auto slab = m_slab[szc];
+
+	if (!slab || !slab->try_free_fast(ptr))
+		free_sizeclass_slow(ptr, szc);
+}
+
 }
 #endif /* HEAP_H */
@@ -0,0 +1,92 @@
+/**
+ * File: /ObjectPool.h
+ * Project: include
+ * Created Date: Monday, October 19th 2026, 6:02:41 pm
+ * Author: Harikrishnan
+ */
+
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include "Heap.h"
+
+#include <new>
+#include <utility>
+
+namespace SmallAlloc
+{
+
+// Smallest slab size class whose slots fit size bytes at the given alignment. Slots start at a
+// cache line offset from the page, so an alloc size that is a multiple of align keeps every slot
+// aligned.
+constexpr SizeClass object_sizeclass(size_t size, size_t align)
+{
+	auto szc = size_to_sizeclass[size - 1];
+
+	while (szc < NUM_SIZE_CLASSES && sizeclass_to_allocsize[szc] % align)
+		szc++;
+
+	return szc;
+}
+
+// Allocates T straight from its slab class in the heap; the size class is resolved at compile time.
+template <typename T>
+class ObjectPool
+{
+public:
+	static_assert(sizeof(T) <= std::size(size_to_sizeclass), "ObjectPool type is too large for a slab");
+	static_assert(alignof(T) <= CACHELINE_SIZE, "ObjectPool type is over aligned");
+
+	static constexpr SizeClass SIZE_CLASS = object_sizeclass(sizeof(T), alignof(T));
+
+	static_assert(SIZE_CLASS < NUM_SIZE_CLASSES, "No slab size class fits ObjectPool type");
+
+	explicit ObjectPool(Heap &heap = Heap::thread_heap()) : m_heap(heap)
+	{}
+
+	void *alloc()
+	{
+		return m_heap.alloc_sizeclass(SIZE_CLASS);
+	}
+
+	void free(void *ptr)
+	{
+		m_heap.free_sizeclass(ptr, SIZE_CLASS);
+	}
+
+	template <typename... Args>
+	T *make(Args &&... args)
+	{
+		auto ptr = alloc();
+
+		if (!ptr)
+			throw std::bad_alloc();
+
+		try
+		{
+			return new (ptr) T(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			free(ptr);
+			throw;
+		}
+	}
+
+	void destroy(T *obj)
+	{
+		if (obj)
+		{
+			obj->~T();
+			free(obj);
+		}
+	}
+
+private:
+	Heap &m_heap;
+};
+
+}
+
+#endif /* OBJECT_POOL_H */
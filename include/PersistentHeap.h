@@ -0,0 +1,43 @@
+/**
+ * File: /PersistentHeap.h
+ * Project: include
+ * Created Date: Monday, October 19th 2026, 11:12:40 pm
+ * Author: Harikrishnan
+ */
+
+
+#ifndef PERSISTENTHEAP_H
+#define PERSISTENTHEAP_H
+
+#include "SharedHeap.h"
+
+namespace SmallAlloc
+{
+
+// A SharedHeap kept in a file. An empty or new file is formatted with the given size; an existing
+// heap is mapped at whatever address the kernel picks and recovered, so objects reachable from
+// the root are intact after a restart. The file is locked while the heap is open; a heap opened
+// on a file that is already locked is not valid.
+class PersistentHeap : public SharedHeap
+{
+public:
+	PersistentHeap(const char *path, size_t size);
+	~PersistentHeap();
+
+	PersistentHeap(const PersistentHeap &heap_rhs) = delete;
+	PersistentHeap &operator=(const PersistentHeap &heap_rhs) = delete;
+
+	bool created() const;
+	// Writes the heap back to the file; until then a crash of the machine may lose updates.
+	bool flush();
+
+private:
+	int m_fd = -1;
+	void *m_mapping = nullptr;
+	size_t m_size = 0;
+	bool m_created = false;
+};
+
+}
+
+#endif /* PERSISTENTHEAP_H */
@@ -0,0 +1,64 @@
+/**
+ * File: /SharedHeap.h
+ * Project: include
+ * Created Date: Monday, October 19th 2026, 9:48:16 pm
+ * Author: Harikrishnan
+ */
+
+
+#ifndef SHAREDHEAP_H
+#define SHAREDHEAP_H
+
+#include "BuddyManager/BuddyManagerMeta.h"
+
+namespace SmallAlloc
+{
+
+struct SharedHeapHeader;
+
+// A heap that lives entirely inside a shared mapping, such as a memfd or shm_open object, and
+// refers to its own memory by offsets only, so every process may map it at a different address.
+// Blocks up to the buddy page size come from buddy chunks, small sizes from slab pages carved out
+// of them. Any process can allocate and free under the heap's process-shared lock; remote_free
+// never takes the lock, so a consumer can release a producer's buffers without contending with it.
+class SharedHeap
+{
+public:
+	using Offset = BuddyManager::Offset;
+
+	// Formats the mapping as an empty heap.
+	SharedHeap(void *mapping, size_t size);
+	// Attaches to a heap another process has already formatted.
+	explicit SharedHeap(void *mapping);
+
+	bool is_valid() const;
+	// Rebuilds the free lists and releases the lock after a user exited mid-operation. Only call
+	// it while no other process is using the heap.
+	void recover();
+
+	void *alloc(size_t size);
+	void free(void *ptr, size_t ptr_size);
+	void remote_free(void *ptr, size_t ptr_size);
+
+	Offset to_offset(const void *ptr) const;
+	void *from_offset(Offset offset) const;
+	size_t capacity() const;
+
+	// The root object is how a process that reopens the heap finds its data again.
+	void set_root(void *ptr);
+	void *get_root() const;
+
+protected:
+	SharedHeap() : m_header(nullptr)
+	{}
+
+	void format(void *mapping, size_t size);
+	void attach(void *mapping);
+
+private:
+	SharedHeapHeader *m_header;
+};
+
+}
+
+#endif /* SHAREDHEAP_H */
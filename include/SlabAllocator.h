@@ -4,6 +4,7 @@
 #include "common.h"
 #include "Utility/IList.h"
 
+#include <algorithm>
 #include <functional>
 #include <cassert>
 
@@ -17,26 +18,49 @@ class SlabAllocator
 {
 public:
 	using AlignedAlloc = std::function<void *(Size, Size)>;
+	using AlignedAllocZeroed = std::function<void *(Size, Size, bool &is_zeroed)>;
 	using Free = std::function<void (void *page, Size)>;
+	using ObjectCallback = std::function<void (void *obj)>;
+
+	static constexpr Size CACHE_LINE_SIZE = 64;
 
 	SlabAllocator(uint32_t alloc_size, uint32_t page_size, AlignedAlloc aligned_alloc_page,
-				  Free free_page);
+				  Free free_page, Size color_step = CACHE_LINE_SIZE);
+	SlabAllocator(uint32_t alloc_size, uint32_t page_size, AlignedAllocZeroed aligned_alloc_page,
+				  Free free_page, Size color_step = CACHE_LINE_SIZE);
+	// Object cache mode: every slot of a page is constructed when the page is populated and
+	// destructed when it is released, so freed objects stay constructed. The free list link is kept
+	// after the object instead of over it.
+	SlabAllocator(uint32_t object_size, uint32_t page_size, AlignedAlloc aligned_alloc_page,
+				  Free free_page, ObjectCallback constructor, ObjectCallback destructor,
+				  Size color_step = CACHE_LINE_SIZE);
+	~SlabAllocator();
 
 	void *alloc();
+	void *calloc();
 	void free(void *ptr);
+
+	inline void *try_alloc_fast();
+	inline bool try_free_fast(void *ptr);
+
 	void remote_free(void *ptr);
+	void remote_free(void *first, void *last);
 	bool reclaim_remote_free();
+	bool reserve(Count count);
 	Size size();
 
-	using object_pointer_t = uint16_t;
 	using object_count_t = uint16_t;
 
+	static constexpr uint32_t reciprocal_of(Size size)
+	{
+		return UINT32_MAX / size + 1;
+	}
+
 #define SLAB_PAGE_SKIP_SIZE (SLAB_PAGE_HEADER_SIZE + sizeof(SlabPageList::Node))
-#define ADDRESS_OF(ind)		(reinterpret_cast<void *>(reinterpret_cast<char *>(this) + \
-								SLAB_PAGE_SKIP_SIZE + (ind) * m_object_size))
-#define INDEX_OF(ptr)		((static_cast<char *>(ptr) - SLAB_PAGE_SKIP_SIZE - \
-								reinterpret_cast<char *>(this)) / m_object_size)
-#define INDEX_AT(ind)		(*static_cast<object_pointer_t *>(ADDRESS_OF(ind)))
+#define ADDRESS_OF(ind)		(reinterpret_cast<char *>(this) + SLAB_PAGE_SKIP_SIZE + m_color + \
+								(ind) * m_object_size)
+#define FREE_NODE(p)		reinterpret_cast<FreeNode *>(p)
+#define OBJECT_OF(node)		(reinterpret_cast<char *>(node) - m_link_offset)
 
 
 	struct SlabPageHeader
@@ -49,120 +73,274 @@ public:
 			this->align = rhs.align;
 		}
 
-		static SlabPageHeader *build(void *page, uint16_t object_size, object_count_t max_object_count)
+		static SlabPageHeader *build(void *page, uint16_t object_size, object_count_t max_object_count,
+									 uint32_t reciprocal, uint16_t color, uint16_t link_offset, bool zeroed)
 		{
 			static_assert(sizeof(SlabAllocator::SlabPageHeader) == SLAB_PAGE_HEADER_SIZE,
-						  "SlabPageHeader cannot be stored in 16 bytes");
+						  "SlabPageHeader cannot be stored in 48 bytes");
 
-			return new (page) SlabPageHeader(object_size, max_object_count);
+			return new (page) SlabPageHeader(object_size, max_object_count, reciprocal, color, link_offset,
+											 zeroed);
 		}
 
 		void *alloc()
 		{
-			auto free_ind = m_next_object;
+			auto block = m_free;
 
-			assert(free_ind <= m_max_object_count);
-
-			if (free_ind < m_max_object_count)
+			if (block)
 			{
-				m_next_object++;
-				m_free_count--;
-				return ADDRESS_OF(free_ind);
+				m_free = block->next;
+				m_used++;
+				return OBJECT_OF(block);
 			}
 
-			free_ind = m_native_fl;
+			return alloc_slow();
+		}
 
-			assert(free_ind <= m_max_object_count);
+		inline void *try_alloc_fast()
+		{
+			auto block = m_free;
 
-			if (free_ind < m_max_object_count)
-			{
-				m_native_fl = INDEX_AT(free_ind);
-				m_free_count--;
-				return ADDRESS_OF(free_ind);
-			}
+			if (!block || m_used + 1 == m_max_object_count)
+				return nullptr;
 
-			return nullptr;
+			m_free = block->next;
+			m_used++;
+			return OBJECT_OF(block);
 		}
 
 		void free(void *ptr)
 		{
-			auto free_ind = INDEX_OF(ptr);
-
-			assert(free_ind <= m_max_object_count);
+			auto block = FREE_NODE(static_cast<char *>(ptr) + m_link_offset);
 
-			INDEX_AT(free_ind) = m_native_fl;
-			m_native_fl = free_ind;
-			m_free_count++;
+			assert(m_used > 0);
+			assert(index_of(ptr) < m_reserved && ADDRESS_OF(index_of(ptr)) == ptr);
 
-			assert(m_free_count <= m_max_object_count);
+			block->next = m_local_free;
+			m_local_free = block;
+			m_used--;
+			m_flags &= ~SLAB_PAGE_ZEROED;
 		}
 
 		inline bool is_page_full()
 		{
-			return m_free_count == 0;
+			return m_used == m_max_object_count;
+		}
+
+		inline void mark_page_full()
+		{
+			m_flags |= SLAB_PAGE_FULL;
+		}
+
+		inline bool clear_page_full()
+		{
+			auto was_full = (m_flags & SLAB_PAGE_FULL) != 0;
+
+			m_flags &= ~SLAB_PAGE_FULL;
+			return was_full;
 		}
 
-		inline bool was_page_full()
+		// Until the first free, every slot handed out was carved from the zeroed page and only
+		// its free list link was written.
+		inline bool is_page_zeroed()
 		{
-			return m_free_count == 1;
+			return (m_flags & SLAB_PAGE_ZEROED) != 0;
 		}
 
 		inline bool is_page_empty()
 		{
-			return m_free_count == m_max_object_count;
+			return m_used == 0;
+		}
+
+		inline object_count_t used_count()
+		{
+			return m_used;
+		}
+
+		// Reserves every slot of a fresh page.
+		void carve()
+		{
+			m_extend_count = m_max_object_count - m_reserved;
+			extend();
+		}
+
+		// Reserves and constructs every slot of a fresh page.
+		void populate(const ObjectCallback &constructor)
+		{
+			carve();
+
+			for (object_count_t ind = 0; ind < m_reserved; ind++)
+				constructor(ADDRESS_OF(ind));
+		}
+
+		void depopulate(const ObjectCallback &destructor)
+		{
+			assert(m_used == 0);
+
+			for (object_count_t ind = 0; ind < m_reserved; ind++)
+				destructor(ADDRESS_OF(ind));
+		}
+
+		inline object_count_t index_of(void *ptr)
+		{
+			auto offset = static_cast<uint64_t>(static_cast<char *>(ptr) - ADDRESS_OF(0));
+			return (offset * m_reciprocal) >> 32;
+		}
+
+		// Start of the slot that ptr points into.
+		inline void *object_of(void *ptr)
+		{
+			return ADDRESS_OF(index_of(ptr));
 		}
 
 	private:
 
-		static constexpr auto SLAB_PAGE_HEADER_SIZE = 16;
+		using FreeNode = utility::FreeList::Node;
+
+		static constexpr auto SLAB_PAGE_HEADER_SIZE = 48;
+		static constexpr auto SLAB_PAGE_EXTEND_SIZE = 4096;
+		static constexpr uint8_t SLAB_PAGE_FULL = 0x1;
+		static constexpr uint8_t SLAB_PAGE_ZEROED = 0x2;
 
 		union
 		{
 			struct
 			{
-				object_pointer_t m_next_object;
-				object_pointer_t m_native_fl;
-				object_count_t m_free_count;
-				object_pointer_t m_object_size;
+				FreeNode *m_free;
+				FreeNode *m_local_free;
+				uint32_t m_reciprocal;
+				object_count_t m_used;
+				object_count_t m_reserved;
+				object_count_t m_extend_count;
+				uint16_t m_object_size;
 				object_count_t m_max_object_count;
+				uint16_t m_color;
+				uint16_t m_link_offset;
+				uint8_t m_flags;
 			};
 
 			std::aligned_storage_t<SLAB_PAGE_HEADER_SIZE> align;
 		};
 
-		SlabPageHeader(uint16_t object_size, object_count_t max_object_count) : m_next_object(0),
-			m_native_fl(max_object_count), m_free_count(max_object_count), m_object_size(object_size),
-			m_max_object_count(max_object_count)
+		SlabPageHeader(uint16_t object_size, object_count_t max_object_count, uint32_t reciprocal,
+					   uint16_t color, uint16_t link_offset, bool zeroed)
+			: m_free(nullptr), m_local_free(nullptr), m_reciprocal(reciprocal), m_used(0), m_reserved(0),
+			m_extend_count(std::max(1, SLAB_PAGE_EXTEND_SIZE / object_size)),
+			m_object_size(object_size), m_max_object_count(max_object_count), m_color(color),
+			m_link_offset(link_offset), m_flags(zeroed ? SLAB_PAGE_ZEROED : 0)
 		{}
+
+		void *alloc_slow()
+		{
+			if (m_local_free)
+			{
+				m_free = m_local_free;
+				m_local_free = nullptr;
+				return alloc();
+			}
+
+			assert(m_reserved <= m_max_object_count);
+
+			if (m_reserved < m_max_object_count)
+			{
+				extend();
+				return alloc();
+			}
+
+			return nullptr;
+		}
+
+		void extend()
+		{
+			auto count = std::min<object_count_t>(m_extend_count, m_max_object_count - m_reserved);
+			auto first = ADDRESS_OF(m_reserved);
+			auto last = first + (count - 1) * m_object_size;
+
+			for (auto block = first; block < last; block += m_object_size)
+				FREE_NODE(block + m_link_offset)->next = FREE_NODE(block + m_object_size + m_link_offset);
+
+			FREE_NODE(last + m_link_offset)->next = nullptr;
+			m_free = FREE_NODE(first + m_link_offset);
+			m_reserved += count;
+		}
 	};
 
 #undef SLAB_PAGE_SKIP_SIZE
 #undef ADDRESS_OF
-#undef INDEX_OF
-#undef INDEX_AT
+#undef FREE_NODE
+#undef OBJECT_OF
 
 private:
 
 	using SlabPageList = utility::List;
 	using SlabObjectRemoteFreeList = utility::FreeListAtomic;
 
-	const AlignedAlloc m_aligned_alloc_page;
+	static constexpr auto NUM_OCCUPANCY_BINS = 4;
+
+	const AlignedAllocZeroed m_aligned_alloc_page;
 	const Free m_free_page;
 	const Size m_alloc_size;
 	const Size m_page_size;
 	const Count m_max_alloc_count;
+	const Count m_occupancy_scale;
+	const uint32_t m_reciprocal;
+	const Size m_color_step;
+	const Size m_color_limit;
+	Size m_link_offset = 0;
+	ObjectCallback m_constructor;
+	ObjectCallback m_destructor;
+	Size m_next_color = 0;
 	Count m_page_count = 0;
 	SlabPageHeader *m_first_page;
-	SlabPageList m_freelist;
-	SlabPageList m_fullpages_list;
+	SlabPageList m_partial_pages[NUM_OCCUPANCY_BINS];
 	SlabObjectRemoteFreeList m_remote_freelist;
 
 	SlabPageHeader *alloc_page();
+	void free_page(SlabPageHeader *page);
 	void *alloc_from_first_page();
 	void *alloc_from_new_page();
-	SlabPageHeader *get_page(void *ptr);
+	inline SlabPageHeader *get_page(void *ptr);
+	Count occupancy_bin(Count used_count);
+
+	static constexpr Size object_align(Size object_size)
+	{
+		return std::min<Size>(object_size & -object_size, CACHE_LINE_SIZE);
+	}
+
+	static constexpr Size link_offset(Size object_size)
+	{
+		return (object_size + alignof(utility::FreeList::Node) - 1) & -alignof(utility::FreeList::Node);
+	}
+
+	static constexpr Size object_stride(Size object_size)
+	{
+		auto align = std::max<Size>(object_align(object_size), alignof(utility::FreeList::Node));
+		return (link_offset(object_size) + sizeof(utility::FreeList::Node) + align - 1) & -align;
+	}
 };
 
+inline SlabAllocator::SlabPageHeader *SlabAllocator::get_page(void *ptr)
+{
+	auto addr = reinterpret_cast<uintptr_t>(ptr);
+	return reinterpret_cast<SlabPageHeader *>(addr - (addr & (m_page_size - 1)));
+}
+
+inline void *SlabAllocator::try_alloc_fast()
+{
+	return m_first_page ? m_first_page->try_alloc_fast() : nullptr;
+}
+
+inline bool SlabAllocator::try_free_fast(void *ptr)
+{
+	auto page = get_page(ptr);
+
+	if (page != m_first_page)
+		return false;
+
+	page->free(ptr);
+	return true;
+}
+
 }
 }
 
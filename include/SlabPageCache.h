@@ -0,0 +1,76 @@
+/**
+ * File: /SlabPageCache.h
+ * Project: include
+ * Created Date: Monday, October 19th 2026, 10:12:40 am
+ * Author: Harikrishnan
+ */
+
+
+#ifndef SLABPAGECACHE_H
+#define SLABPAGECACHE_H
+
+#include "common.h"
+#include "Utility/IList.h"
+
+#include <cassert>
+
+namespace SmallAlloc
+{
+
+class SlabPageCache
+{
+public:
+	static constexpr Size MIN_PAGE_SIZE = 4 * 1024;
+	static constexpr Size MAX_PAGE_SIZE = 256 * 1024;
+	static constexpr Size MAX_CACHED_BYTES = 256 * 1024;
+
+	SlabPageCache() : m_cached_count()
+	{}
+
+	void *get(Size page_size)
+	{
+		auto bin = get_bin(page_size);
+		auto page = m_cached_pages[bin].pop();
+
+		if (page)
+			m_cached_count[bin]--;
+
+		return page;
+	}
+
+	bool put(void *page, Size page_size)
+	{
+		auto bin = get_bin(page_size);
+
+		if ((m_cached_count[bin] + 1) * page_size > MAX_CACHED_BYTES)
+			return false;
+
+		m_cached_pages[bin].push(static_cast<PageList::Node *>(page));
+		m_cached_count[bin]++;
+		return true;
+	}
+
+private:
+	using PageList = utility::FreeList;
+
+	static constexpr Count NUM_PAGE_SIZES = 7;
+
+	static Count get_bin(Size page_size)
+	{
+		Count bin = 0;
+
+		assert(page_size >= MIN_PAGE_SIZE && page_size <= MAX_PAGE_SIZE);
+
+		while ((MIN_PAGE_SIZE << bin) < page_size)
+			bin++;
+
+		return bin;
+	}
+
+	PageList m_cached_pages[NUM_PAGE_SIZES];
+	Count m_cached_count[NUM_PAGE_SIZES];
+};
+
+}
+
+#endif /* SLABPAGECACHE_H */
@@ -216,6 +216,20 @@ public:
 		}
 	}
 
+	void push(Node *first, Node *last)
+	{
+		while (true)
+		{
+			auto head = m_head.load(std::memory_order_acquire);
+			last->next = head;
+
+			if (m_head.compare_exchange_weak(head, first, std::memory_order_release))
+				break;
+
+			_mm_pause();
+		}
+	}
+
 	Node *pop()
 	{
 		while (true)
@@ -307,6 +321,11 @@ public:
 		return m_head.last;
 	}
 
+	Node *end()
+	{
+		return &m_head;
+	}
+
 	void push_back(Node *node)
 	{
 		node->prev = back();
@@ -331,7 +350,7 @@ public:
 		return head;
 	}
 
-	void remove(Node *node)
+	static void remove(Node *node)
 	{
 		node->prev->next = node->next;
 		node->next->prev = node->prev;
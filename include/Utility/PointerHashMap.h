@@ -11,6 +11,7 @@
 
 #include <memory>
 #include <cstddef>
+#include <cstdlib>
 #include <string>
 #include <iterator>
 
@@ -55,11 +56,21 @@ public:
 
 private:
 
-	std::unique_ptr<Cell[]> m_buckets;
+	// Buckets come from the C heap so the map stays usable underneath a replaced operator new.
+	struct BucketDeleter
+	{
+		void operator()(Cell *buckets) const
+		{
+			std::free(buckets);
+		}
+	};
+
+	std::unique_ptr<Cell[], BucketDeleter> m_buckets;
 	count_t m_num_buckets;
 	uint64_t m_element_count;
 	double m_load_factor;
 
+	static Cell *alloc_buckets(count_t num_buckets);
 	void resize();
 	index_t get_ideal_bucket(pointer_t key);
 	index_t get_next_bucket(index_t bucket);
@@ -0,0 +1,129 @@
+/**
+ * File: /Arena.cpp
+ * Project: src
+ * Created Date: Monday, October 19th 2026, 7:31:52 pm
+ * Author: Harikrishnan
+ */
+
+
+#include "Arena.h"
+#include "Allocator.h"
+#include "BuddyManager/BuddyManager.h"
+
+using namespace SmallAlloc;
+
+constexpr size_t MAX_BLOCK_SIZE = BuddyManager::BuddyManager::get_page_size();
+constexpr size_t MAX_BLOCK_ALLOC_SIZE = MAX_BLOCK_SIZE / 4;
+
+struct Arena::Block
+{
+	Block *prev;
+	size_t size;
+};
+
+struct Arena::LargeAlloc
+{
+	LargeAlloc *prev;
+	void *ptr;
+	size_t size;
+	size_t align;
+};
+
+static size_t block_size_for(size_t block_size)
+{
+	size_t size = Arena::MIN_BLOCK_SIZE;
+
+	while (size < block_size && size < MAX_BLOCK_SIZE)
+		size *= 2;
+
+	return size;
+}
+
+Arena::Arena(Heap &parent, size_t initial_block_size)
+	: m_parent(parent), m_initial_block_size(block_size_for(initial_block_size)),
+	  m_next_block_size(m_initial_block_size)
+{}
+
+Arena::~Arena()
+{
+	reset();
+}
+
+size_t Arena::size()
+{
+	return m_size;
+}
+
+void *Arena::alloc_slow(size_t size, size_t align)
+{
+	if (!align || (align & (align - 1)))
+		return nullptr;
+
+	if (size > MAX_BLOCK_ALLOC_SIZE || align > MIN_BLOCK_SIZE)
+		return alloc_large(size, align);
+
+	auto block_size = m_next_block_size;
+
+	while (block_size < sizeof(Block) + size + align)
+		block_size *= 2;
+
+	auto block = static_cast<Block *>(m_parent.alloc(block_size));
+
+	if (!block)
+		return nullptr;
+
+	block->prev = m_blocks;
+	block->size = block_size;
+	m_blocks = block;
+	m_cur = reinterpret_cast<char *>(block + 1);
+	m_end = reinterpret_cast<char *>(block) + block_size;
+	m_size += block_size;
+	m_next_block_size = std::min(block_size * 2, MAX_BLOCK_SIZE);
+
+	return alloc(size, align);
+}
+
+void *Arena::alloc_large(size_t size, size_t align)
+{
+	auto large = static_cast<LargeAlloc *>(alloc(sizeof(LargeAlloc), alignof(LargeAlloc)));
+
+	if (!large)
+		return nullptr;
+
+	auto ptr = align <= MIN_ALIGNMENT ? m_parent.alloc(size) : m_parent.alloc_aligned(size, align);
+
+	if (!ptr)
+		return nullptr;
+
+	*large = {m_large, ptr, size, align};
+	m_large = large;
+	m_size += size;
+
+	return ptr;
+}
+
+void Arena::reset()
+{
+	// Large allocations are recorded inside the blocks, so release them first.
+	for (auto large = m_large; large; large = large->prev)
+	{
+		if (large->align <= MIN_ALIGNMENT)
+			m_parent.free(large->ptr, large->size);
+		else
+			m_parent.free_aligned(large->ptr, large->size, large->align);
+	}
+
+	for (auto block = m_blocks; block;)
+	{
+		auto prev = block->prev;
+
+		m_parent.free(block, block->size);
+		block = prev;
+	}
+
+	m_cur = m_end = nullptr;
+	m_blocks = nullptr;
+	m_large = nullptr;
+	m_next_block_size = m_initial_block_size;
+	m_size = 0;
+}
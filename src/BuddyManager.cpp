@@ -8,6 +8,7 @@
 
 #include "BuddyManager/BuddyManager.h"
 
+#include <cstring>
 #include <vector>
 
 using namespace SmallAlloc::BuddyManager;
@@ -19,10 +20,11 @@ using Count = SmallAlloc::Count;
 #define INT_TO_PTR(i)	reinterpret_cast<void *>(i)
 
 BuddyManager::BuddyManager(Size alloc_limit, std::function<void *(Size, Size)> aligned_alloc_chunk,
-						   std::function<void (void *, Size)> free_chunk)
+						   std::function<void (void *, Size)> free_chunk, bool zeroed_chunks)
 	: m_aligned_alloc_chunk(aligned_alloc_chunk), m_free_chunk(free_chunk),
-	  m_freelist(), m_alloc_limit(alloc_limit), m_chunk_count(0),
-	  m_num_class_sizes(BMMeta::get_num_sizeclasses()), m_chunk_meta_map()
+	  m_freelist(), m_alloc_limit(alloc_limit), m_chunk_count(0), m_min_chunk_count(1),
+	  m_num_class_sizes(BMMeta::get_num_sizeclasses()), m_zeroed_chunks(zeroed_chunks),
+	  m_retain_chunks(false), m_chunk_meta_map()
 {}
 
 BuddyManager::~BuddyManager()
@@ -53,6 +55,7 @@ BuddyManager::BMMetaNode *BuddyManager::alloc_chunk()
 	}
 
 	new (meta_ptr) BMMetaNode();
+	memset(meta_ptr->m_dirty, m_zeroed_chunks ? 0 : 0xFF, sizeof(meta_ptr->m_dirty));
 	m_chunk_meta_map.insert(chunk, static_cast<void *>(meta_ptr));
 	meta_ptr->m_managed_chunk = chunk;
 	m_alloc_limit -= BuddyPageSize;
@@ -108,6 +111,26 @@ void BuddyManager::mark_block_as_in_use(BMMetaNode *meta, BuddyFreeNode *ptr, Si
 	meta->meta.mark_block_as_in_use(get_ptr_offset(meta, ptr), szc);
 }
 
+// Returns true if no part of the block was handed out before. Such a block is still zero except
+// for the free list node written at its start.
+bool BuddyManager::mark_block_as_dirty(BMMetaNode *meta, BuddyFreeNode *ptr, Size size)
+{
+	auto first = get_ptr_offset(meta, ptr) / BuddyMinAllocSize;
+	auto last = first + size / BuddyMinAllocSize;
+	bool was_clean = true;
+
+	for (auto unit = first; unit < last; unit++)
+	{
+		auto &dirty_byte = meta->m_dirty[unit / 8];
+		uint8_t dirty_bit = 1 << (unit % 8);
+
+		was_clean &= (dirty_byte & dirty_bit) == 0;
+		dirty_byte |= dirty_bit;
+	}
+
+	return was_clean;
+}
+
 BuddyManager::BuddyFreeNode *BuddyManager::alloc_internal(SizeClass szc)
 {
 	if (szc == m_num_class_sizes)
@@ -160,17 +183,15 @@ bool BuddyManager::free_internal(BMMetaNode *meta, BuddyFreeNode *ptr, SizeClass
 	return false;
 }
 
-void *BuddyManager::alloc(Size size)
+void *BuddyManager::alloc(Size size, bool *is_zeroed)
 {
 	if (size > BuddyPageSize || size < BuddyMinAllocSize)
 		return nullptr;
 
-	auto ret_mem = alloc_internal(BMMeta::get_sizeclass(size));
-
-	if (ret_mem)
-		return ret_mem;
+	auto szc = BMMeta::get_sizeclass(size);
+	auto ret_mem = alloc_internal(szc);
 
-	if (m_alloc_limit)
+	if (!ret_mem && m_alloc_limit)
 	{
 		auto chunk_meta = alloc_chunk();
 
@@ -181,11 +202,22 @@ void *BuddyManager::alloc(Size size)
 			chunk->meta = chunk_meta;
 			freelist.push(chunk);
 
-			return alloc_internal(BMMeta::get_sizeclass(size));
+			ret_mem = alloc_internal(szc);
 		}
 	}
 
-	return nullptr;
+	if (ret_mem)
+	{
+		auto zeroed = mark_block_as_dirty(ret_mem->meta, ret_mem, BuddyMinAllocSize << szc);
+
+		if (zeroed)
+			memset(static_cast<void *>(ret_mem), 0, sizeof(BuddyFreeNode));
+
+		if (is_zeroed)
+			*is_zeroed = zeroed;
+	}
+
+	return ret_mem;
 }
 
 void BuddyManager::free(void *ptr, Size size)
@@ -193,21 +225,13 @@ void BuddyManager::free(void *ptr, Size size)
 	if (!ptr || size > BuddyPageSize || size < BuddyMinAllocSize)
 		return;
 
-	auto get_page = [&](auto ptr)
-	{
-		return INT_TO_PTR(PTR_TO_INT(ptr) - (PTR_TO_INT(ptr) & (BuddyPageSize - 1)));
-	};
-
 	auto ptr_node = static_cast<BuddyFreeNode *>(ptr);
-	auto chunk = get_page(ptr);
-	auto meta = static_cast<BMMetaNode *>(m_chunk_meta_map.find(chunk));
+	auto meta = get_chunk_meta(ptr);
 	auto szc = BMMeta::get_sizeclass(size);
 
-	assert(meta != nullptr);
-
 	if (free_internal(meta, ptr_node, szc))
 	{
-		if (m_chunk_count > 1)
+		if (!m_retain_chunks && m_chunk_count > m_min_chunk_count)
 		{
 			free_chunk(meta);
 		}
@@ -220,6 +244,142 @@ void BuddyManager::free(void *ptr, Size size)
 	}
 }
 
+bool BuddyManager::resize(void *ptr, Size old_size, Size new_size)
+{
+	if (!ptr || new_size > BuddyPageSize || new_size < BuddyMinAllocSize)
+		return false;
+
+	auto ptr_node = static_cast<BuddyFreeNode *>(ptr);
+	auto meta = get_chunk_meta(ptr);
+	auto offset = get_ptr_offset(meta, ptr_node);
+	auto old_szc = BMMeta::get_sizeclass(old_size);
+	auto new_szc = BMMeta::get_sizeclass(new_size);
+	auto upper_half = [&](SizeClass szc)
+	{
+		return get_ptr(meta, offset + (BuddyMinAllocSize << szc));
+	};
+
+	if (new_szc > old_szc)
+	{
+		if (offset & ((BuddyMinAllocSize << new_szc) - 1))
+			return false;
+
+		for (auto szc = old_szc; szc < new_szc; szc++)
+		{
+			if (!block_is_free(meta, upper_half(szc), szc))
+				return false;
+		}
+
+		for (auto szc = old_szc; szc < new_szc; szc++)
+		{
+			m_freelist[szc].remove(upper_half(szc));
+			mark_block_as_free(meta, ptr_node, szc);
+		}
+
+		mark_block_as_dirty(meta, ptr_node, BuddyMinAllocSize << new_szc);
+	}
+	else
+	{
+		for (auto szc = old_szc; szc-- > new_szc;)
+		{
+			auto buddy = upper_half(szc);
+
+			buddy->meta = meta;
+			m_freelist[szc].push(buddy);
+			mark_block_as_in_use(meta, ptr_node, szc);
+		}
+	}
+
+	return true;
+}
+
+// Forgets every allocation at once. Retained chunks become single free blocks again but keep
+// their dirty bitmaps, so recycled memory is not reported as zeroed.
+void BuddyManager::reset(bool retain_chunks)
+{
+	for (auto &freelist : m_freelist)
+		freelist = BuddyFreeList();
+
+	if (!retain_chunks)
+	{
+		std::for_each(m_chunk_meta_map.begin(), m_chunk_meta_map.end(), [this](auto cell)
+		{
+			if (cell.first)
+			{
+				m_free_chunk(cell.first, BuddyPageSize);
+				static_cast<BMMetaNode *>(cell.second)->~BMMetaNode();
+				m_free_chunk(cell.second, sizeof(BMMetaNode));
+			}
+		});
+
+		m_chunk_meta_map = SmallAlloc::utility::PointerHashMap();
+		m_alloc_limit += m_chunk_count * BuddyPageSize;
+		m_chunk_count = 0;
+		m_min_chunk_count = 1;
+		return;
+	}
+
+	auto &freelist = m_freelist[BMMeta::get_sizeclass(BuddyPageSize)];
+
+	std::for_each(m_chunk_meta_map.begin(), m_chunk_meta_map.end(), [&freelist](auto cell)
+	{
+		if (cell.first)
+		{
+			auto meta = static_cast<BMMetaNode *>(cell.second);
+			auto chunk = static_cast<BuddyFreeNode *>(cell.first);
+
+			new (&meta->meta) BMMeta();
+			chunk->meta = meta;
+			freelist.push(chunk);
+		}
+	});
+}
+
+// Makes sure enough whole chunks to hold size bytes are free, mapping only those that are
+// missing, and keeps that many mapped on top of the chunks in use even once they are unused.
+bool BuddyManager::reserve(Size size)
+{
+	auto &freelist = m_freelist[BMMeta::get_sizeclass(BuddyPageSize)];
+	Count needed = (size + BuddyPageSize - 1) / BuddyPageSize;
+	Count free_chunks = 0;
+
+	for (auto node = freelist.peek(); node; node = node->get_next())
+		free_chunks++;
+
+	auto used_chunks = m_chunk_count - free_chunks;
+
+	for (; free_chunks < needed; free_chunks++)
+	{
+		auto chunk_meta = m_alloc_limit ? alloc_chunk() : nullptr;
+
+		if (!chunk_meta)
+			return false;
+
+		auto chunk = static_cast<BuddyFreeNode *>(chunk_meta->m_managed_chunk);
+		chunk->meta = chunk_meta;
+		freelist.push(chunk);
+	}
+
+	m_min_chunk_count = std::max<Size>(m_min_chunk_count, used_chunks + needed);
+	return true;
+}
+
+// Keeps every chunk mapped once it is free; only reset(false) and the destructor release them.
+void BuddyManager::set_retain_chunks(bool retain_chunks)
+{
+	m_retain_chunks = retain_chunks;
+}
+
+BuddyManager::BMMetaNode *BuddyManager::get_chunk_meta(void *ptr)
+{
+	auto chunk = INT_TO_PTR(PTR_TO_INT(ptr) - (PTR_TO_INT(ptr) & (BuddyPageSize - 1)));
+	auto meta = static_cast<BMMetaNode *>(m_chunk_meta_map.find(chunk));
+
+	assert(meta != nullptr);
+
+	return meta;
+}
+
 SmallAlloc::Size BuddyManager::size()
 {
 	return m_chunk_count * (BuddyPageSize + sizeof(BMMetaNode));
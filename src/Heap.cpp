@@ -1,107 +1,1407 @@
 #include "BuddyManager/BuddyManager.h"
 #include "SlabSizeClass.h"
 #include "SlabAllocator.h"
+#include "SlabPageCache.h"
 #include "Heap.h"
 #include "jemalloc/jemalloc.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif // _WIN32
+
 void *je_aligned_alloc(size_t, size_t);
 void je_free(void *);
 
-namespace SmallAlloc
-{
+namespace SmallAlloc
+{
+
+struct SlabClassInfo
+{
+	uint32_t alloc_size;
+	uint32_t page_size;
+};
+
+constexpr auto NUM_SLAB_CLASSES = NUM_SIZE_CLASSES + NUM_CACHELINE_SIZE_CLASSES;
+
+constexpr auto slab_class_info = []()
+{
+	std::array<SlabClassInfo, NUM_SLAB_CLASSES> info{};
+
+	for (auto szc = 0; szc < NUM_SIZE_CLASSES; szc++)
+	{
+		info[szc] = {static_cast<uint32_t>(sizeclass_to_allocsize[szc]),
+					 static_cast<uint32_t>(sizeclass_to_pagesize[szc])};
+	}
+
+	for (auto szc = 0; szc < NUM_CACHELINE_SIZE_CLASSES; szc++)
+	{
+		info[NUM_SIZE_CLASSES + szc] = {static_cast<uint32_t>(cacheline_sizeclass_to_allocsize[szc]),
+										static_cast<uint32_t>(cacheline_sizeclass_to_pagesize[szc])};
+	}
+
+	return info;
+}();
+
+constexpr Count NUM_ALIGNMENTS = 3;
+
+constexpr auto aligned_sizeclass_table = []()
+{
+	std::array<std::array<SizeClass, NUM_SIZE_CLASSES>, NUM_ALIGNMENTS> table{};
+
+	for (Count i = 0; i < NUM_ALIGNMENTS; i++)
+	{
+		auto align = (MIN_ALIGNMENT * 2) << i;
+
+		for (SizeClass szc = 0; szc < NUM_SIZE_CLASSES; szc++)
+		{
+			auto aligned_szc = szc;
+
+			while (aligned_szc < NUM_SIZE_CLASSES && sizeclass_to_allocsize[aligned_szc] % align)
+				aligned_szc++;
+
+			table[i][szc] = aligned_szc;
+		}
+	}
+
+	return table;
+}();
+
+// Maps every buddy chunk, and the first chunk of every huge mapping, to the heap that owns
+// it. Leaves are allocated on first use and never released.
+class ChunkMap
+{
+public:
+	static constexpr unsigned CHUNK_BITS = 22;
+
+	static void *find(const void *ptr)
+	{
+		auto index = chunk_index(ptr);
+		auto leaf = m_root[index >> LEAF_BITS].load(std::memory_order_acquire);
+
+		return leaf ? leaf[index & LEAF_MASK].load(std::memory_order_acquire) : nullptr;
+	}
+
+	static void insert(const void *chunk, void *info)
+	{
+		auto index = chunk_index(chunk);
+		get_leaf(index >> LEAF_BITS)[index & LEAF_MASK].store(info, std::memory_order_release);
+	}
+
+	static void erase(const void *chunk)
+	{
+		insert(chunk, nullptr);
+	}
+
+private:
+	using Leaf = std::atomic<void *>;
+
+	static constexpr unsigned ADDRESS_BITS = 48;
+	static constexpr unsigned LEAF_BITS = 13;
+	static constexpr unsigned ROOT_BITS = ADDRESS_BITS - CHUNK_BITS - LEAF_BITS;
+	static constexpr uintptr_t LEAF_MASK = (1 << LEAF_BITS) - 1;
+
+	static std::atomic<Leaf *> m_root[1 << ROOT_BITS];
+
+	static uintptr_t chunk_index(const void *ptr)
+	{
+		return reinterpret_cast<uintptr_t>(ptr) >> CHUNK_BITS;
+	}
+
+	static Leaf *get_leaf(uintptr_t root_index)
+	{
+		auto leaf = m_root[root_index].load(std::memory_order_acquire);
+
+		if (leaf)
+			return leaf;
+
+		auto new_leaf = static_cast<Leaf *>(::calloc(1 << LEAF_BITS, sizeof(Leaf)));
+
+		if (m_root[root_index].compare_exchange_strong(leaf, new_leaf, std::memory_order_acq_rel))
+			return new_leaf;
+
+		::free(new_leaf);
+		return leaf;
+	}
+};
+
+std::atomic<ChunkMap::Leaf *> ChunkMap::m_root[1 << ROOT_BITS];
+
+static_assert((1ULL << ChunkMap::CHUNK_BITS) == BuddyManager::BuddyManager::get_page_size(),
+			  "ChunkMap must track chunks of the buddy page size");
+
+// Caller provided memory split into naturally aligned buddy chunks. Chunks keep their chunk map
+// entries for the lifetime of the region, so handing them out and back needs no system calls.
+class FixedRegion
+{
+public:
+	static constexpr Size CHUNK_SIZE = BuddyManager::BuddyManager::get_page_size();
+
+	~FixedRegion()
+	{
+		for (Count i = 0; i < m_chunk_count; i++)
+		{
+			auto chunk = m_base + i * CHUNK_SIZE;
+
+			::free(ChunkMap::find(chunk));
+			ChunkMap::erase(chunk);
+		}
+	}
+
+	// A null range still makes the region active, just without any chunks.
+	void init(void *memory, Size size)
+	{
+		auto start = reinterpret_cast<uintptr_t>(memory);
+		auto base = (start + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+
+		m_active = true;
+		m_base = reinterpret_cast<char *>(base);
+		m_chunk_count = memory && base < start + size ? (start + size - base) / CHUNK_SIZE : 0;
+	}
+
+	bool active()
+	{
+		return m_active;
+	}
+
+	Count chunk_count()
+	{
+		return m_chunk_count;
+	}
+
+	void *chunk(Count index)
+	{
+		return m_base + index * CHUNK_SIZE;
+	}
+
+	void *pop_chunk()
+	{
+		return m_free_chunks.pop();
+	}
+
+	void push_chunk(void *chunk)
+	{
+		m_free_chunks.push(static_cast<utility::FreeList::Node *>(chunk));
+	}
+
+private:
+	char *m_base;
+	Count m_chunk_count;
+	bool m_active;
+	utility::FreeList m_free_chunks;
+};
+
+class Heap::HeapImpl
+{
+public:
+	static std::unique_ptr<HeapImpl> build(Size alloc_limit, unsigned flags, bool fixed_region = false,
+										   void *memory = nullptr, Size memory_size = 0)
+	{
+		Size slab_size = sizeof(SlabAllocator::SlabAllocator) * NUM_SLAB_CLASSES;
+		auto impl = static_cast<HeapImpl *>(::calloc(1, sizeof(HeapImpl) + slab_size));
+
+		// The inline fast path in Heap.h goes through these and leaves classes without a
+		// constructed slab to alloc_slow, which constructs them.
+		std::fill(std::begin(impl->m_live_slabs), std::end(impl->m_live_slabs), nullptr);
+
+#ifdef _WIN32
+		bool zeroed_chunks = false;
+#else
+		bool zeroed_chunks = true;
+#endif // _WIN32
+
+		new (&impl->m_region) FixedRegion();
+
+		if (fixed_region)
+		{
+			impl->m_region.init(memory, memory_size);
+			alloc_limit = impl->m_region.chunk_count() * FixedRegion::CHUNK_SIZE;
+			zeroed_chunks = false;
+		}
+
+		new (&impl->bm) BuddyManager::BuddyManager(alloc_limit, [impl](Size align, Size size)
+		{
+			return impl->alloc_chunk(align, size);
+		}, [impl](void *ptr, Size size)
+		{
+			impl->free_chunk(ptr, size);
+		}, zeroed_chunks);
+
+		if (flags & LOCKED)
+		{
+			impl->m_locked = true;
+			impl->bm.set_retain_chunks(true);
+		}
+
+		new (&impl->m_page_cache) SlabPageCache();
+		new (&impl->m_huge_size) std::atomic<Size>(0);
+		new (&impl->m_huge_lock) std::mutex();
+		new (&impl->m_huge_list) utility::List();
+		new (&impl->m_remote_large) utility::FreeListAtomic();
+
+		if (fixed_region)
+			impl->adopt_region();
+
+		return std::unique_ptr<HeapImpl>(impl);
+	}
+
+	// Registers every chunk of the fixed region and takes them all up front; they are never handed
+	// back, so the heap makes no further chunk requests.
+	void adopt_region()
+	{
+		Count adopted = 0;
+
+		for (; adopted < m_region.chunk_count(); adopted++)
+		{
+			auto info = static_cast<ChunkInfo *>(::calloc(1, sizeof(ChunkInfo) + CHUNK_UNIT_COUNT));
+
+			if (!info)
+				break;
+
+			info->owner = this;
+			ChunkMap::insert(m_region.chunk(adopted), info);
+			m_region.push_chunk(m_region.chunk(adopted));
+		}
+
+		bm.set_retain_chunks(true);
+		bm.reserve(adopted * FixedRegion::CHUNK_SIZE);
+	}
+
+	~HeapImpl()
+	{
+		destroy_slabs();
+		free_all_huge();
+	}
+
+	// Drops every allocation of this heap without visiting them one by one. Buddy chunks are
+	// either kept for the next round or handed back.
+	void reset(bool retain_chunks)
+	{
+		destroy_slabs();
+		free_all_huge();
+
+		m_page_cache.~SlabPageCache();
+		new (&m_page_cache) SlabPageCache();
+		m_remote_large.popAll();
+		bm.reset(retain_chunks || m_locked);
+	}
+
+	static void operator delete(void *ptr)
+	{
+		::free(ptr);
+	}
+
+	void *alloc(size_t size)
+	{
+		if (size <= MAX_SMALL_SIZE)
+			return get_slab(size_to_sizeclass[size - 1]).alloc();
+
+		if (size <= bm.get_page_size())
+			return alloc_large(large_size(size));
+
+		return alloc_huge(huge_size(size));
+	}
+
+	void free(void *ptr, size_t size)
+	{
+		if (size <= MAX_SMALL_SIZE)
+			m_slab[size_to_sizeclass[size - 1]].free(ptr);
+		else if (size <= bm.get_page_size())
+			bm.free(ptr, large_size(size));
+		else
+			free_huge(ptr, huge_size(size));
+	}
+
+	void *realloc(void *ptr, size_t old_size, size_t new_size)
+	{
+		if (!new_size)
+		{
+			if (ptr)
+				free(ptr, old_size);
+
+			return nullptr;
+		}
+
+		if (!ptr)
+			return alloc(new_size);
+
+		auto old_block_size = block_size(old_size);
+		auto new_block_size = block_size(new_size);
+
+		if (old_block_size == new_block_size)
+			return ptr;
+
+		if (old_size > MAX_SMALL_SIZE && new_size > MAX_SMALL_SIZE)
+		{
+			if (new_size <= bm.get_page_size())
+			{
+				if (old_size <= bm.get_page_size() && bm.resize(ptr, old_block_size, new_block_size))
+				{
+					tag_large(ptr, new_block_size);
+					return ptr;
+				}
+			}
+			else if (old_size > bm.get_page_size())
+			{
+				auto new_ptr = realloc_huge(ptr, old_block_size, new_block_size);
+
+				if (new_ptr)
+					return new_ptr;
+			}
+		}
+
+		auto new_ptr = alloc(new_size);
+
+		if (new_ptr)
+		{
+			memcpy(new_ptr, ptr, std::min(old_size, new_size));
+			free(ptr, old_size);
+		}
+
+		return new_ptr;
+	}
+
+	void *alloc_sizeclass(SizeClass szc)
+	{
+		return get_slab(szc).alloc();
+	}
+
+	void free_sizeclass(void *ptr, SizeClass szc)
+	{
+		m_slab[szc].free(ptr);
+	}
+
+	bool reserve_bytes(size_t size, bool prefault)
+	{
+		m_prefault_chunks = prefault;
+
+		auto reserved = bm.reserve(size);
+
+		m_prefault_chunks = false;
+		return reserved;
+	}
+
+	bool reserve(size_t size, size_t count, bool prefault)
+	{
+		if (size <= MAX_SMALL_SIZE)
+		{
+			m_prefault_chunks = prefault;
+
+			auto reserved = get_slab(size_to_sizeclass[size - 1]).reserve(count);
+
+			m_prefault_chunks = false;
+			return reserved;
+		}
+
+		if (size <= bm.get_page_size())
+			return reserve_bytes(count * large_size(size), prefault);
+
+		return false;
+	}
+
+	// Sizes past the cache line classes take a buddy block or a huge mapping, which share no cache
+	// line with anything else either.
+	void *alloc_cacheline(size_t size)
+	{
+		if (size > MAX_CACHELINE_SLAB_SIZE)
+			return alloc_aligned(size, CACHELINE_SIZE);
+
+		return size ? get_slab(cacheline_sizeclass(size)).alloc() : nullptr;
+	}
+
+	void free_cacheline(void *ptr, size_t size)
+	{
+		if (size > MAX_CACHELINE_SLAB_SIZE)
+			free_aligned(ptr, size, CACHELINE_SIZE);
+		else if (size)
+			m_slab[cacheline_sizeclass(size)].free(ptr);
+	}
+
+	void remote_free_cacheline(void *ptr, size_t size);
+
+	void *alloc_aligned(size_t size, size_t align)
+	{
+		if (!size || !align || (align & (align - 1)))
+			return nullptr;
+
+		auto szc = aligned_sizeclass(size, align);
+
+		if (szc != BUDDY_SIZECLASS)
+		{
+			auto ptr = get_slab(szc).alloc();
+
+			if (ptr && align > CACHELINE_SIZE)
+				ptr = reinterpret_cast<void *>((reinterpret_cast<uintptr_t>(ptr) + align - 1) & ~(align - 1));
+
+			return ptr;
+		}
+
+		// The chunk map has one entry per chunk sized window, so a mapping must fill the window it
+		// starts in.
+		if (is_huge_aligned(size, align))
+			return alloc_huge(huge_size(std::max<Size>(size, bm.get_page_size())), align);
+
+		return alloc_large(buddy_size(size, align));
+	}
+
+	void free_aligned(void *ptr, size_t size, size_t align)
+	{
+		auto szc = aligned_sizeclass(size, align);
+
+		if (szc != BUDDY_SIZECLASS)
+			m_slab[szc].free(szc < NUM_SIZE_CLASSES ? ptr : slot_of(ptr, szc));
+		else if (is_huge_aligned(size, align))
+			free_huge(ptr, chunk_info(ptr)->huge_size);
+		else
+			bm.free(ptr, buddy_size(size, align));
+	}
+
+	// Frees memory from any heap without knowing its size; the owner and block size come from
+	// the chunk map and its page tags. current is the calling thread's heap, if any.
+	static void free_global(HeapImpl *current, void *ptr)
+	{
+		auto info = chunk_info(ptr);
+		auto owner = info->owner;
+
+		if (info->huge_size)
+		{
+			owner->free_huge(ptr, info->huge_size);
+			return;
+		}
+
+		auto tag = info->tags[unit_of(ptr)];
+
+		if (tag < TAG_LARGE)
+			free_slab_global(current, owner, ptr, tag - 1);
+		else if (owner == current)
+			owner->bm.free(ptr, large_block_of(tag));
+		else
+			owner->m_remote_large.push(static_cast<utility::FreeListAtomic::Node *>(ptr));
+	}
+
+	static void free_global(HeapImpl *current, void *ptr, size_t size, size_t align)
+	{
+		auto szc = BUDDY_SIZECLASS;
+
+		if (align <= MIN_ALIGNMENT && size <= MAX_SMALL_SIZE)
+			szc = size_to_sizeclass[size - 1];
+		else if (align > MIN_ALIGNMENT)
+			szc = aligned_sizeclass(size, align);
+
+		if (szc == BUDDY_SIZECLASS)
+			free_global(current, ptr);
+		else
+			free_slab_global(current, chunk_info(ptr)->owner, ptr, szc);
+	}
+
+	void remote_free(void *first, void *last, SizeClass szc)
+	{
+		m_slab[szc].remote_free(first, last);
+	}
+
+	static SizeClass cacheline_sizeclass(size_t size)
+	{
+		return NUM_SIZE_CLASSES + size_to_cacheline_sizeclass[(size - 1) / CACHELINE_SIZE];
+	}
+
+	void *calloc(size_t size)
+	{
+		if (size <= MAX_SMALL_SIZE)
+			return get_slab(size_to_sizeclass[size - 1]).calloc();
+
+		if (size <= bm.get_page_size())
+		{
+			bool zeroed = false;
+			auto ptr = alloc_large(large_size(size), &zeroed);
+
+			if (ptr && !zeroed)
+				memset(ptr, 0, size);
+
+			return ptr;
+		}
+
+		return alloc_huge(huge_size(size));
+	}
+
+	size_t size()
+	{
+		return bm.size() + m_huge_size;
+	}
+
+	SlabAllocator::SlabAllocator **slabs()
+	{
+		return m_live_slabs;
+	}
+
+private:
+	static constexpr SizeClass BUDDY_SIZECLASS = NUM_SLAB_CLASSES;
+	static constexpr Size OS_PAGE_SIZE = 4096;
+	static constexpr Size MAPPED_CHUNK_SIZE = 64 * 1024;
+	static constexpr Size CHUNK_UNIT_SIZE = BuddyManager::BuddyManager::get_min_alloc_size();
+	static constexpr Count CHUNK_UNIT_COUNT = BuddyManager::BuddyManager::get_page_size() / CHUNK_UNIT_SIZE;
+	static constexpr uint8_t TAG_LARGE = 0xF0;
+
+	static_assert(NUM_SLAB_CLASSES < TAG_LARGE, "Slab page tags overlap large block tags");
+
+	// Slab pages tag every unit they span with their size class + 1; large blocks tag their first
+	// unit with TAG_LARGE + log2 of their size in units. Huge mappings are also linked into their
+	// owner's m_huge_list through huge_node.
+	struct ChunkInfo
+	{
+		utility::List::Node huge_node;
+		HeapImpl *owner;
+		void *huge_base;
+		Size huge_size;
+		uint8_t tags[0];
+	};
+	static constexpr Size MAX_CACHELINE_SLAB_SIZE = std::size(size_to_cacheline_sizeclass) * CACHELINE_SIZE;
+
+	// Declared first so it outlives bm, whose destructor hands the region's chunks back.
+	FixedRegion m_region;
+	BuddyManager::BuddyManager bm;
+	SlabPageCache m_page_cache;
+	std::atomic<Size> m_huge_size;
+	std::mutex m_huge_lock;
+	utility::List m_huge_list;
+	utility::FreeListAtomic m_remote_large;
+	bool m_prefault_chunks;
+	bool m_locked;
+	SlabAllocator::SlabAllocator *m_live_slabs[NUM_SLAB_CLASSES];
+	SlabAllocator::SlabAllocator m_slab[0];
+
+	void destroy_slabs()
+	{
+		for (auto szc = 0; szc < NUM_SLAB_CLASSES; szc++)
+		{
+			if (m_live_slabs[szc])
+			{
+				m_slab[szc].~SlabAllocator();
+				m_live_slabs[szc] = nullptr;
+			}
+		}
+	}
+
+	SlabAllocator::SlabAllocator &get_slab(SizeClass szc)
+	{
+		if (!m_live_slabs[szc])
+			init_slab(szc);
+
+		return m_slab[szc];
+	}
+
+	// Slots start at a cache line offset from a naturally aligned page, so a slab class
+	// honours any alignment up to CACHELINE_SIZE that divides its alloc size. Larger alignments
+	// take a cache line class slot padded by align - CACHELINE_SIZE, as long as that is smaller
+	// than the buddy block they would need otherwise.
+	static SizeClass aligned_sizeclass(size_t size, size_t align)
+	{
+		auto szc = BUDDY_SIZECLASS;
+		Size szc_size = SIZE_MAX;
+
+		if (align > CACHELINE_SIZE)
+		{
+			auto padded_size = size + align - CACHELINE_SIZE;
+
+			if (padded_size > MAX_CACHELINE_SLAB_SIZE)
+				return BUDDY_SIZECLASS;
+
+			auto cacheline_szc = cacheline_sizeclass(padded_size);
+
+			if (slab_class_info[cacheline_szc].alloc_size < buddy_size(size, align))
+				return cacheline_szc;
+
+			return BUDDY_SIZECLASS;
+		}
+
+		if (size <= MAX_SMALL_SIZE)
+		{
+			szc = size_to_sizeclass[size - 1];
+
+			if (align > MIN_ALIGNMENT)
+				szc = aligned_sizeclass_table[__builtin_ctzl(align / (MIN_ALIGNMENT * 2))][szc];
+
+			if (szc < NUM_SIZE_CLASSES)
+				szc_size = sizeclass_to_allocsize[szc];
+			else
+				szc = BUDDY_SIZECLASS;
+		}
+
+		if (align > MIN_ALIGNMENT && size <= MAX_CACHELINE_SLAB_SIZE)
+		{
+			auto cacheline_szc = cacheline_sizeclass(size);
+
+			if (slab_class_info[cacheline_szc].alloc_size < szc_size)
+				szc = cacheline_szc;
+		}
+
+		return szc;
+	}
+
+	static Size buddy_size(size_t size, size_t align)
+	{
+		Size block = std::max<Size>(align, BuddyManager::BuddyManager::get_min_alloc_size());
+
+		while (block < size)
+			block *= 2;
+
+		return block;
+	}
+
+	// Buddy chunks are mapped straight from the kernel so they start out zeroed; the small
+	// chunk metadata blocks come from the C heap.
+	void *alloc_chunk(Size align, Size size)
+	{
+		if (size < MAPPED_CHUNK_SIZE)
+		{
+#ifdef _WIN32
+			return _aligned_malloc(size, align);
+#else
+			void *ptr = nullptr;
+			posix_memalign(&ptr, align, size);
+			return ptr;
+#endif // _WIN32
+		}
+
+		if (m_region.active())
+		{
+			auto chunk = m_region.pop_chunk();
+
+			if (chunk && m_locked)
+				lock(chunk, size);
+			else if (chunk && m_prefault_chunks)
+				prefault(chunk, size);
+
+			return chunk;
+		}
+
+		auto info = static_cast<ChunkInfo *>(::calloc(1, sizeof(ChunkInfo) + CHUNK_UNIT_COUNT));
+
+		if (!info)
+			return nullptr;
+
+		auto chunk = map_aligned(align, size);
+
+		if (!chunk)
+		{
+			::free(info);
+			return nullptr;
+		}
+
+		if (m_locked)
+			lock(chunk, size);
+		else if (m_prefault_chunks)
+			prefault(chunk, size);
+
+		info->owner = this;
+		ChunkMap::insert(chunk, info);
+		return chunk;
+	}
+
+	void free_chunk(void *ptr, Size size)
+	{
+		if (size < MAPPED_CHUNK_SIZE)
+		{
+#ifdef _WIN32
+			_aligned_free(ptr);
+#else
+			::free(ptr);
+#endif // _WIN32
+			return;
+		}
+
+		if (m_region.active())
+		{
+			m_region.push_chunk(ptr);
+			return;
+		}
+
+		::free(ChunkMap::find(ptr));
+		ChunkMap::erase(ptr);
+		unmap(ptr, size);
+	}
+
+	static void *map_aligned(Size align, Size size)
+	{
+#ifdef _WIN32
+		return _aligned_malloc(size, align);
+#else
+		auto map_size = size + align;
+		auto map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (map == MAP_FAILED)
+			return nullptr;
+
+		auto map_start = reinterpret_cast<uintptr_t>(map);
+		auto chunk_start = (map_start + align - 1) & ~(align - 1);
+
+		if (chunk_start > map_start)
+			munmap(map, chunk_start - map_start);
+
+		munmap(reinterpret_cast<void *>(chunk_start + size), map_start + map_size - chunk_start - size);
+		return reinterpret_cast<void *>(chunk_start);
+#endif // _WIN32
+	}
+
+	// Faults in a freshly mapped, still zeroed range so its first use does not.
+	static void prefault(void *ptr, Size size)
+	{
+#ifdef MADV_POPULATE_WRITE
+		if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+			return;
+#endif // MADV_POPULATE_WRITE
+
+		for (Size offset = 0; offset < size; offset += OS_PAGE_SIZE)
+			static_cast<volatile char *>(ptr)[offset] = 0;
+	}
+
+	// Locking is best effort, as it fails beyond RLIMIT_MEMLOCK; the range is faulted in either way.
+	static void lock(void *ptr, Size size)
+	{
+		prefault(ptr, size);
+
+#ifdef _WIN32
+		VirtualLock(ptr, size);
+#else
+		mlock(ptr, size);
+#endif // _WIN32
+	}
+
+	static void unmap(void *ptr, Size size)
+	{
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		munmap(ptr, size);
+#endif // _WIN32
+	}
+
+	static ChunkInfo *chunk_info(void *ptr)
+	{
+		auto info = static_cast<ChunkInfo *>(ChunkMap::find(ptr));
+
+		assert(info != nullptr);
+
+		return info;
+	}
 
-class Heap::HeapImpl
-{
-public:
-	static std::unique_ptr<HeapImpl> build(Size alloc_limit)
+	static Count unit_of(void *ptr)
+	{
+		return (reinterpret_cast<uintptr_t>(ptr) & (BuddyManager::BuddyManager::get_page_size() - 1)) /
+			   CHUNK_UNIT_SIZE;
+	}
+
+	static Size large_block_of(uint8_t tag)
+	{
+		return CHUNK_UNIT_SIZE << (tag - TAG_LARGE);
+	}
+
+	static void tag_slab_page(void *page, Size page_size, SizeClass szc)
+	{
+		memset(&chunk_info(page)->tags[unit_of(page)], szc + 1, page_size / CHUNK_UNIT_SIZE);
+	}
+
+	static void tag_large(void *ptr, Size block_size)
+	{
+		chunk_info(ptr)->tags[unit_of(ptr)] = TAG_LARGE + __builtin_ctzl(block_size / CHUNK_UNIT_SIZE);
+	}
+
+	static void free_slab_global(HeapImpl *current, HeapImpl *owner, void *ptr, SizeClass szc);
+
+	// An object aligned past a cache line sits somewhere inside its cache line class slot.
+	static void *slot_of(void *ptr, SizeClass szc)
+	{
+		auto page = reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t(slab_class_info[szc].page_size) - 1);
+
+		return reinterpret_cast<SlabAllocator::SlabAllocator::SlabPageHeader *>(page)->object_of(ptr);
+	}
+
+	void *alloc_buddy(Size size, bool *zeroed = nullptr)
+	{
+		if (!m_remote_large.empty())
+			reclaim_remote_large();
+
+		return bm.alloc(size, zeroed);
+	}
+
+	void *alloc_large(Size block_size, bool *zeroed = nullptr)
+	{
+		auto ptr = alloc_buddy(block_size, zeroed);
+
+		if (ptr)
+			tag_large(ptr, block_size);
+
+		return ptr;
+	}
+
+	void reclaim_remote_large()
 	{
-		Size slab_size = sizeof(SlabAllocator::SlabAllocator) * NUM_SIZE_CLASSES;
-		Size buddy_size = sizeof(BuddyManager::BuddyManager);
-		auto impl = static_cast<HeapImpl *>(malloc(buddy_size + slab_size));
+		auto node = m_remote_large.popAll();
 
-		new (&impl->bm) BuddyManager::BuddyManager(alloc_limit, [](auto align, auto size)
+		while (node)
 		{
+			auto ptr = static_cast<void *>(node);
+
+			node = node->get_next();
+			bm.free(ptr, large_block_of(chunk_info(ptr)->tags[unit_of(ptr)]));
+		}
+	}
+
+	bool is_huge_aligned(size_t size, size_t align)
+	{
+		return size > bm.get_page_size() || align > bm.get_page_size();
+	}
+
+	Size large_size(size_t size)
+	{
+		return buddy_size(size, 1);
+	}
+
+	static Size huge_size(size_t size)
+	{
+		return (size + OS_PAGE_SIZE - 1) & ~(OS_PAGE_SIZE - 1);
+	}
+
+	Size block_size(size_t size)
+	{
+		if (size <= MAX_SMALL_SIZE)
+			return sizeclass_to_allocsize[size_to_sizeclass[size - 1]];
+
+		if (size <= bm.get_page_size())
+			return large_size(size);
+
+		return huge_size(size);
+	}
+
+	// Alignments past a page over-map and trim the mapping. Windows cannot trim, so there huge
+	// mappings are aligned to its 64K allocation granularity at most.
+	void *alloc_huge(Size size, Size align = OS_PAGE_SIZE)
+	{
+		if (m_region.active())
+			return nullptr;
+
+		auto info = static_cast<ChunkInfo *>(::calloc(1, sizeof(ChunkInfo)));
+
+		if (!info)
+			return nullptr;
+
 #ifdef _WIN32
-			return _aligned_malloc(size, align);
+		void *ptr = nullptr;
+
+		if (align <= 64 * 1024)
+			ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
 #else
-			void *ptr = nullptr;
-			posix_memalign(&ptr, align, size);
-			return ptr;
+		void *ptr;
+
+		if (align > OS_PAGE_SIZE)
+		{
+			ptr = map_aligned(align, size);
+		}
+		else
+		{
+			ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if (ptr == MAP_FAILED)
+				ptr = nullptr;
+		}
 #endif // _WIN32
-		}, [](auto ptr, auto size)
+
+		if (!ptr)
+		{
+			::free(info);
+			return nullptr;
+		}
+
+		if (m_locked)
+			lock(ptr, size);
+
+		info->owner = this;
+		info->huge_base = ptr;
+		info->huge_size = size;
+		ChunkMap::insert(ptr, info);
+		m_huge_size += size;
+
+		std::lock_guard<std::mutex> guard(m_huge_lock);
+
+		m_huge_list.push_back(&info->huge_node);
+		return ptr;
+	}
+
+	void free_huge(void *ptr, Size size)
+	{
+		auto info = chunk_info(ptr);
+
 		{
+			std::lock_guard<std::mutex> guard(m_huge_lock);
+
+			utility::List::remove(&info->huge_node);
+		}
+
+		::free(info);
+		ChunkMap::erase(ptr);
+
 #ifdef _WIN32
-			_aligned_free(ptr);
+		VirtualFree(ptr, 0, MEM_RELEASE);
 #else
-			::free(ptr);
+		munmap(ptr, size);
 #endif // _WIN32
-		});
+		m_huge_size -= size;
+	}
+
+	void free_all_huge()
+	{
+		while (!m_huge_list.empty())
+		{
+			auto info = reinterpret_cast<ChunkInfo *>(m_huge_list.front());
+			free_huge(info->huge_base, info->huge_size);
+		}
+	}
+
+	void *realloc_huge(void *ptr, Size old_size, Size new_size)
+	{
+#ifdef __LINUX__
+		auto info = chunk_info(ptr);
+		auto new_ptr = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE);
+
+		if (new_ptr == MAP_FAILED)
+			return nullptr;
 
-		auto buddy_alloc = [impl](Size align, Size size)
+		ChunkMap::erase(ptr);
+		info->huge_base = new_ptr;
+		info->huge_size = new_size;
+		ChunkMap::insert(new_ptr, info);
+		m_huge_size += new_size - old_size;
+		return new_ptr;
+#else
+		return nullptr;
+#endif // __LINUX__
+	}
+
+	void init_slab(SizeClass szc)
+	{
+		auto buddy_alloc = [this, szc](Size align, Size size, bool &zeroed)
 		{
-			return impl->bm.alloc(size);
+			auto page = m_page_cache.get(size);
+
+			if (!page)
+				page = alloc_buddy(size, &zeroed);
+
+			if (page)
+				tag_slab_page(page, size, szc);
+
+			return page;
 		};
-		auto buddy_free = [impl](void *page, Size size)
+		auto buddy_free = [this](void *page, Size size)
 		{
-			impl->bm.free(page, size);
+			if (!m_page_cache.put(page, size))
+				bm.free(page, size);
 		};
 
-		for (auto szc = 0; szc < NUM_SIZE_CLASSES; szc++)
+		new (&m_slab[szc]) SlabAllocator::SlabAllocator(slab_class_info[szc].alloc_size,
+														 slab_class_info[szc].page_size,
+														 buddy_alloc, buddy_free);
+		m_live_slabs[szc] = &m_slab[szc];
+	}
+};
+
+// Every thread's cache is registered, so a heap that goes away can drop the frees other threads
+// still have batched for it. The per cache lock is only ever contended by discard_all.
+class Heap::RemoteFreeCache
+{
+public:
+	RemoteFreeCache()
+	{
+		std::lock_guard<std::mutex> guard(m_caches_lock);
+
+		m_next = m_caches;
+
+		if (m_next)
+			m_next->m_prev = this;
+
+		m_caches = this;
+	}
+
+	~RemoteFreeCache()
+	{
+		flush();
+
+		std::lock_guard<std::mutex> guard(m_caches_lock);
+
+		if (m_prev)
+			m_prev->m_next = m_next;
+		else
+			m_caches = m_next;
+
+		if (m_next)
+			m_next->m_prev = m_prev;
+	}
+
+	// Only the owning thread touches a buffer's entries, so m_lock is needed just to flush a
+	// buffer or hand it to another heap, which discard_all may race with.
+	void remote_free(HeapImpl *heap, void *ptr, SizeClass szc)
+	{
+		auto &buffer = get_buffer(heap);
+
+		buffer.pending[buffer.count++] = {szc, ptr};
+
+		if (buffer.count == RemoteFreeBatchSize)
 		{
-			new (&impl->m_slab[szc]) SlabAllocator::SlabAllocator(sizeclass_to_allocsize[szc],
-																  sizeclass_to_pagesize[szc],
-																  buddy_alloc, buddy_free);
+			std::lock_guard<std::mutex> guard(m_lock);
+			flush(buffer);
 		}
+	}
 
-		return std::unique_ptr<HeapImpl>(impl);
+	void flush()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		for (auto &buffer : m_buffers)
+		{
+			flush(buffer);
+			buffer.heap.store(nullptr, std::memory_order_relaxed);
+		}
 	}
 
-	void *alloc(size_t size)
+	// Once this returns, no thread holds or is flushing frees for heap; their owners drop
+	// whatever was batched for it.
+	static void discard_all(HeapImpl *heap)
+	{
+		std::lock_guard<std::mutex> guard(m_caches_lock);
+
+		for (auto cache = m_caches; cache; cache = cache->m_next)
+		{
+			std::lock_guard<std::mutex> cache_guard(cache->m_lock);
+
+			for (auto &buffer : cache->m_buffers)
+			{
+				if (buffer.heap.load(std::memory_order_relaxed) == heap)
+					buffer.heap.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	using FreeNode = utility::FreeList::Node;
+
+	static constexpr Count RemoteFreeBatchSize = 32;
+	static constexpr Count RemoteFreeHeapCount = 4;
+
+	struct RemoteFreeBuffer
 	{
-		return m_slab[size_to_sizeclass[size - 1]].alloc();
+		std::atomic<HeapImpl *> heap;
+		Count count;
+		std::pair<SizeClass, void *> pending[RemoteFreeBatchSize];
+	};
+
+	static std::mutex m_caches_lock;
+	static RemoteFreeCache *m_caches;
+
+	std::mutex m_lock;
+	RemoteFreeCache *m_prev = nullptr;
+	RemoteFreeCache *m_next = nullptr;
+	RemoteFreeBuffer m_buffers[RemoteFreeHeapCount] = {};
+	Count m_victim = 0;
+
+	RemoteFreeBuffer &get_buffer(HeapImpl *heap)
+	{
+		for (auto &buffer : m_buffers)
+		{
+			if (buffer.heap.load(std::memory_order_relaxed) == heap)
+				return buffer;
+		}
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		RemoteFreeBuffer *unused = nullptr;
+
+		for (auto &buffer : m_buffers)
+		{
+			if (!buffer.heap.load(std::memory_order_relaxed))
+			{
+				unused = &buffer;
+				break;
+			}
+		}
+
+		if (!unused)
+		{
+			unused = &m_buffers[m_victim++ % RemoteFreeHeapCount];
+			flush(*unused);
+		}
+
+		unused->count = 0;
+		unused->heap.store(heap, std::memory_order_relaxed);
+		return *unused;
 	}
 
-	void free(void *ptr, size_t size)
+	// Called with m_lock held. Entries batched for a discarded heap are dropped.
+	void flush(RemoteFreeBuffer &buffer)
 	{
-		m_slab[size_to_sizeclass[size - 1]].free(ptr);
+		auto heap = buffer.heap.load(std::memory_order_relaxed);
+		auto pending = buffer.pending;
+		auto count = buffer.count;
+
+		buffer.count = 0;
+
+		if (!heap)
+			return;
+
+		std::sort(pending, pending + count, [](auto &lhs, auto &rhs)
+		{
+			return lhs.first < rhs.first;
+		});
+
+		for (Count i = 0; i < count;)
+		{
+			auto szc = pending[i].first;
+			auto first = static_cast<FreeNode *>(pending[i++].second);
+			auto last = first;
+
+			while (i < count && pending[i].first == szc)
+			{
+				last->next = static_cast<FreeNode *>(pending[i++].second);
+				last = last->next;
+			}
+
+			heap->remote_free(first, last, szc);
+		}
 	}
+};
+
+std::mutex Heap::RemoteFreeCache::m_caches_lock;
+Heap::RemoteFreeCache *Heap::RemoteFreeCache::m_caches;
+
+Heap::RemoteFreeCache &Heap::remote_free_cache()
+{
+	static thread_local RemoteFreeCache cache;
+	return cache;
+}
+
+void Heap::HeapImpl::free_slab_global(HeapImpl *current, HeapImpl *owner, void *ptr, SizeClass szc)
+{
+	if (szc >= NUM_SIZE_CLASSES)
+		ptr = slot_of(ptr, szc);
+
+	if (owner == current)
+		owner->m_slab[szc].free(ptr);
+	else
+		remote_free_cache().remote_free(owner, ptr, szc);
+}
+
+void Heap::HeapImpl::remote_free_cacheline(void *ptr, size_t size)
+{
+	if (size > MAX_CACHELINE_SLAB_SIZE)
+		free_global(nullptr, ptr);
+	else if (size)
+		remote_free_cache().remote_free(this, ptr, cacheline_sizeclass(size));
+}
+
+// Heaps of exited threads are parked here instead of being destroyed, since objects allocated
+// from them may still be alive; the next thread to need a heap adopts one. Nothing here goes
+// through operator new, so a replaced operator new can build on thread_heap().
+class ThreadHeapPool
+{
+public:
+	static constexpr size_t THREAD_HEAP_ALLOC_LIMIT = std::numeric_limits<size_t>::max();
 
-	void remote_free(void *ptr, size_t size)
+	static Heap *acquire()
 	{
-		m_slab[size_to_sizeclass[size - 1]].remote_free(ptr);
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		if (!m_free_heaps)
+		{
+			auto node = static_cast<PooledHeap *>(::malloc(sizeof(PooledHeap)));
+			return &(new (node) PooledHeap{Heap(THREAD_HEAP_ALLOC_LIMIT), nullptr})->heap;
+		}
+
+		auto node = m_free_heaps;
+		m_free_heaps = node->next;
+		return &node->heap;
 	}
 
-	size_t size()
+	static void release(Heap *heap)
 	{
-		return bm.size();
+		std::lock_guard<std::mutex> guard(m_lock);
+		auto node = reinterpret_cast<PooledHeap *>(heap);
+
+		node->next = m_free_heaps;
+		m_free_heaps = node;
 	}
 
 private:
-	BuddyManager::BuddyManager bm;
-	SlabAllocator::SlabAllocator m_slab[0];
+	struct PooledHeap
+	{
+		Heap heap;
+		PooledHeap *next;
+	};
+
+	static_assert(std::is_standard_layout<PooledHeap>::value, "PooledHeap must start with its heap");
+
+	static std::mutex m_lock;
+	static PooledHeap *m_free_heaps;
+};
+
+std::mutex ThreadHeapPool::m_lock;
+ThreadHeapPool::PooledHeap *ThreadHeapPool::m_free_heaps;
+
+static thread_local Heap *t_thread_heap;
+static thread_local bool t_thread_heap_released;
+
+class ThreadHeapReleaser
+{
+public:
+	~ThreadHeapReleaser()
+	{
+		ThreadHeapPool::release(t_thread_heap);
+		t_thread_heap = nullptr;
+		t_thread_heap_released = true;
+	}
 };
 
-Heap::Heap(size_t alloc_limit) : impl(HeapImpl::build(alloc_limit))
+Heap &Heap::thread_heap()
+{
+	if (!t_thread_heap)
+	{
+		t_thread_heap = ThreadHeapPool::acquire();
+
+		// A heap needed while the thread is being torn down stays with it.
+		if (!t_thread_heap_released)
+		{
+			static thread_local ThreadHeapReleaser releaser;
+			(void) releaser;
+		}
+	}
+
+	return *t_thread_heap;
+}
+
+Heap::Heap(size_t alloc_limit, unsigned flags)
+	: impl(HeapImpl::build(alloc_limit, flags)), m_slab(impl->slabs())
 {}
 
-Heap::Heap(Heap &&heap_rhs) : impl(std::move(heap_rhs.impl))
+Heap::Heap(void *memory, size_t size, unsigned flags)
+	: impl(HeapImpl::build(0, flags, true, memory, size)), m_slab(impl->slabs())
 {}
 
-Heap::~Heap() = default;
+Heap::Heap(Heap &&heap_rhs) : impl(std::move(heap_rhs.impl)), m_slab(heap_rhs.m_slab)
+{}
+
+Heap::~Heap()
+{
+	if (impl)
+		RemoteFreeCache::discard_all(impl.get());
+}
 
-void *Heap::alloc(size_t size)
+void *Heap::alloc_slow(size_t size)
 {
 	return impl->alloc(size);
 }
 
-void Heap::free(void *ptr, size_t size)
+void Heap::free_slow(void *ptr, size_t size)
 {
 	impl->free(ptr, size);
 }
 
+void *Heap::alloc_sizeclass_slow(SizeClass szc)
+{
+	return impl->alloc_sizeclass(szc);
+}
+
+void Heap::free_sizeclass_slow(void *ptr, SizeClass szc)
+{
+	impl->free_sizeclass(ptr, szc);
+}
+
+void *Heap::alloc_aligned(size_t size, size_t align)
+{
+	return impl->alloc_aligned(size, align);
+}
+
+void Heap::free_aligned(void *ptr, size_t size, size_t align)
+{
+	impl->free_aligned(ptr, size, align);
+}
+
+void *Heap::calloc(size_t count, size_t size)
+{
+	if (!count || !size || count > SIZE_MAX / size)
+		return nullptr;
+
+	return impl->calloc(count * size);
+}
+
+void *Heap::realloc(void *ptr, size_t old_size, size_t new_size)
+{
+	return impl->realloc(ptr, old_size, new_size);
+}
+
 void Heap::remote_free(void *ptr, size_t size)
 {
-	impl->free(ptr, size);
+	if (size > MAX_SMALL_SIZE)
+		HeapImpl::free_global(nullptr, ptr);
+	else
+		remote_free_cache().remote_free(impl.get(), ptr, size_to_sizeclass[size - 1]);
+}
+
+void *Heap::alloc_cacheline(size_t size)
+{
+	return impl->alloc_cacheline(size);
+}
+
+void Heap::free_cacheline(void *ptr, size_t size)
+{
+	impl->free_cacheline(ptr, size);
+}
+
+void Heap::remote_free_cacheline(void *ptr, size_t size)
+{
+	impl->remote_free_cacheline(ptr, size);
+}
+
+void Heap::free_global(void *ptr)
+{
+	HeapImpl::free_global(t_thread_heap ? t_thread_heap->impl.get() : nullptr, ptr);
+}
+
+void Heap::free_global(void *ptr, size_t ptr_size, size_t align)
+{
+	HeapImpl::free_global(t_thread_heap ? t_thread_heap->impl.get() : nullptr, ptr, ptr_size, align);
+}
+
+void Heap::flush_remote()
+{
+	remote_free_cache().flush();
+}
+
+// No memory of this heap may be in use. Frees other threads still have batched for it are dropped.
+void Heap::reset(bool retain_chunks)
+{
+	RemoteFreeCache::discard_all(impl.get());
+	impl->reset(retain_chunks);
+}
+
+// Small sizes get carved slab pages, larger ones free buddy chunks; capacity the heap already has
+// counts towards the reservation. Sizes above the buddy page size are mapped on demand and cannot
+// be reserved.
+bool Heap::reserve(size_t size, size_t count, bool prefault)
+{
+	if (!size || !count)
+		return true;
+
+	return impl->reserve(size, count, prefault);
+}
+
+// Keeps whole buddy chunks for size bytes free on top of the chunks in use; calling it again only
+// maps what is missing.
+bool Heap::reserve_bytes(size_t size, bool prefault)
+{
+	return impl->reserve_bytes(size, prefault);
 }
 
 size_t Heap::size()
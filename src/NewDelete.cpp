@@ -0,0 +1,172 @@
+/**
+ * File: /NewDelete.cpp
+ * Project: src
+ * Created Date: Monday, October 19th 2026, 4:12:27 pm
+ * Author: Harikrishnan
+ */
+
+
+#include "Heap.h"
+
+#include <algorithm>
+#include <new>
+
+using SmallAlloc::Heap;
+using SmallAlloc::MIN_ALIGNMENT;
+
+// Linking this file replaces the global operator new/delete with the calling thread's heap.
+// Sized deletes go straight to the size class; unsized ones look the block up in the chunk map.
+
+static constexpr size_t DEFAULT_NEW_ALIGNMENT = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+static inline size_t new_size(size_t size)
+{
+	return size ? size : 1;
+}
+
+// No object needs more alignment than the lowest set bit of its size, so sizes that are odd
+// multiples of MIN_ALIGNMENT take the plain size classes.
+static inline size_t default_align(size_t size)
+{
+	size = new_size(size);
+	return std::min(DEFAULT_NEW_ALIGNMENT, size & (0 - size));
+}
+
+static inline void *alloc_nothrow(size_t size, size_t align) noexcept
+{
+	auto &heap = Heap::thread_heap();
+
+	if (align <= MIN_ALIGNMENT)
+		return heap.alloc(new_size(size));
+
+	return heap.alloc_aligned(new_size(size), align);
+}
+
+static void *alloc(size_t size, size_t align)
+{
+	void *ptr;
+
+	while (!(ptr = alloc_nothrow(size, align)))
+	{
+		auto handler = std::get_new_handler();
+
+		if (!handler)
+			throw std::bad_alloc();
+
+		handler();
+	}
+
+	return ptr;
+}
+
+static inline void free_sized(void *ptr, size_t size, size_t align) noexcept
+{
+	if (ptr)
+		Heap::free_global(ptr, new_size(size), align);
+}
+
+static inline void free_unsized(void *ptr) noexcept
+{
+	if (ptr)
+		Heap::free_global(ptr);
+}
+
+void *operator new(size_t size)
+{
+	return alloc(size, default_align(size));
+}
+
+void *operator new[](size_t size)
+{
+	return alloc(size, default_align(size));
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return alloc_nothrow(size, default_align(size));
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return alloc_nothrow(size, default_align(size));
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+	return alloc(size, static_cast<size_t>(align));
+}
+
+void *operator new[](size_t size, std::align_val_t align)
+{
+	return alloc(size, static_cast<size_t>(align));
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+	return alloc_nothrow(size, static_cast<size_t>(align));
+}
+
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+	return alloc_nothrow(size, static_cast<size_t>(align));
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+	free_sized(ptr, size, default_align(size));
+}
+
+void operator delete[](void *ptr, size_t size) noexcept
+{
+	free_sized(ptr, size, default_align(size));
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	free_unsized(ptr);
+}
+
+void operator delete(void *ptr, size_t size, std::align_val_t align) noexcept
+{
+	free_sized(ptr, size, static_cast<size_t>(align));
+}
+
+void operator delete[](void *ptr, size_t size, std::align_val_t align) noexcept
+{
+	free_sized(ptr, size, static_cast<size_t>(align));
+}
@@ -0,0 +1,91 @@
+/**
+ * File: /PersistentHeap.cpp
+ * Project: src
+ * Created Date: Monday, October 19th 2026, 11:20:03 pm
+ * Author: Harikrishnan
+ */
+
+
+#include "PersistentHeap.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+using namespace SmallAlloc;
+
+PersistentHeap::PersistentHeap(const char *path, size_t size)
+{
+#ifndef _WIN32
+	struct stat file_stat;
+
+	if ((m_fd = open(path, O_RDWR | O_CREAT, 0600)) < 0)
+		return;
+
+	// The lock goes away with the descriptor, so a crashed owner does not keep the heap locked.
+	if (flock(m_fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+		return;
+	}
+
+	if (fstat(m_fd, &file_stat) != 0)
+		return;
+
+	m_created = file_stat.st_size == 0;
+	m_size = m_created ? size : file_stat.st_size;
+
+	if (m_created && ftruncate(m_fd, m_size) != 0)
+		return;
+
+	m_mapping = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+
+	if (m_mapping == MAP_FAILED)
+	{
+		m_mapping = nullptr;
+		return;
+	}
+
+	if (m_created)
+	{
+		format(m_mapping, m_size);
+	}
+	else
+	{
+		attach(m_mapping);
+
+		if (is_valid())
+			recover();
+	}
+#endif // _WIN32
+}
+
+PersistentHeap::~PersistentHeap()
+{
+#ifndef _WIN32
+	if (m_mapping)
+		munmap(m_mapping, m_size);
+
+	if (m_fd >= 0)
+		close(m_fd);
+#endif // _WIN32
+}
+
+bool PersistentHeap::created() const
+{
+	return m_created;
+}
+
+bool PersistentHeap::flush()
+{
+#ifndef _WIN32
+	return m_mapping && msync(m_mapping, m_size, MS_SYNC) == 0;
+#else
+	return false;
+#endif // _WIN32
+}
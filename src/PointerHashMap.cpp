@@ -8,6 +8,7 @@
 
 #include "Utility/PointerHashMap.h"
 
+#include <new>
 #include <stdexcept>
 #include <limits>
 #include <cassert>
@@ -28,7 +29,7 @@ PointerHashMap::PointerHashMap() : PointerHashMap(DEFAULT_LOAD_FACTOR, DEFAULT_N
 {}
 
 PointerHashMap::PointerHashMap(double load_factor, count_t num_buckets)
-	: m_buckets(std::make_unique<Cell[]>(num_buckets)), m_num_buckets(num_buckets),
+	: m_buckets(alloc_buckets(num_buckets)), m_num_buckets(num_buckets),
 	  m_element_count(0), m_load_factor(load_factor)
 {
 	if (m_load_factor > 0.99)
@@ -37,6 +38,16 @@ PointerHashMap::PointerHashMap(double load_factor, count_t num_buckets)
 	std::memset(m_buckets.get(), 0, m_num_buckets * sizeof(Cell));
 }
 
+PointerHashMap::Cell *PointerHashMap::alloc_buckets(count_t num_buckets)
+{
+	auto buckets = static_cast<Cell *>(std::calloc(num_buckets, sizeof(Cell)));
+
+	if (!buckets)
+		throw std::bad_alloc();
+
+	return buckets;
+}
+
 count_t PointerHashMap::size()
 {
 	return m_element_count;
@@ -137,7 +148,7 @@ void PointerHashMap::resize()
 
 	m_element_count = 0;
 	m_num_buckets *= 2;
-	m_buckets = std::make_unique<Cell[]>(m_num_buckets);
+	m_buckets.reset(alloc_buckets(m_num_buckets));
 	auto buckets = old_buckets.get();
 
 	for (auto bucket = 0; bucket < old_num_buckets; bucket++)
@@ -0,0 +1,514 @@
+/**
+ * File: /SharedHeap.cpp
+ * Project: src
+ * Created Date: Monday, October 19th 2026, 10:03:37 pm
+ * Author: Harikrishnan
+ */
+
+
+#include "SharedHeap.h"
+#include "BuddyManager/BuddyManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <emmintrin.h>
+
+namespace SmallAlloc
+{
+
+using Offset = SharedHeap::Offset;
+
+constexpr Size CHUNK_SIZE = BuddyManager::BuddyManager::get_page_size();
+constexpr Size MIN_BLOCK_SIZE = BuddyManager::BuddyManager::get_min_alloc_size();
+constexpr Size MIN_SLAB_SIZE = 16;
+constexpr Size MAX_SLAB_SIZE = 2048;
+constexpr Size SLAB_PAGE_SIZE = 64 * 1024;
+constexpr Count NUM_SHARED_SLAB_CLASSES = 8;
+constexpr uint64_t SHARED_HEAP_MAGIC = 0x5348415245444850;
+
+static_assert(MIN_SLAB_SIZE << (NUM_SHARED_SLAB_CLASSES - 1) == MAX_SLAB_SIZE,
+			  "Shared slab classes must cover every size up to MAX_SLAB_SIZE");
+static_assert(std::atomic<Offset>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+			  "Process shared atomics must be lock free");
+
+using ChunkMeta = BuddyManager::BuddyManagerMeta<CHUNK_SIZE, MIN_BLOCK_SIZE>;
+
+constexpr Count NUM_BLOCK_CLASSES = ChunkMeta::get_num_sizeclasses_const();
+
+// Offset 0 is the header itself, so it doubles as the null offset in every list.
+struct SharedHeapHeader
+{
+	uint64_t magic;
+	Size size;
+	Count chunk_count;
+	Offset chunk_base;
+	std::atomic<uint32_t> lock;
+	Offset root;
+	Offset block_free[NUM_BLOCK_CLASSES];
+	Offset slab_free[NUM_SHARED_SLAB_CLASSES];
+	Offset slab_pages[NUM_SHARED_SLAB_CLASSES];
+	std::atomic<Offset> remote_slab[NUM_SHARED_SLAB_CLASSES];
+	std::atomic<Offset> remote_block;
+	ChunkMeta meta[0];
+};
+
+using Header = SharedHeapHeader;
+
+struct BlockNode
+{
+	Offset next;
+	Offset prev;
+};
+
+struct RemoteBlock
+{
+	Offset next;
+	SizeClass szc;
+};
+
+// Every slab page starts with this header. The in use bitmap is what recovery rebuilds the
+// slab free lists from.
+struct SlabPage
+{
+	Offset next_page;
+	Size object_size;
+	uint64_t in_use[SLAB_PAGE_SIZE / MIN_SLAB_SIZE / 64];
+};
+
+class SharedLockGuard
+{
+public:
+	explicit SharedLockGuard(std::atomic<uint32_t> &lock) : m_lock(lock)
+	{
+		while (m_lock.exchange(1, std::memory_order_acquire))
+		{
+			while (m_lock.load(std::memory_order_relaxed))
+				_mm_pause();
+		}
+	}
+
+	~SharedLockGuard()
+	{
+		m_lock.store(0, std::memory_order_release);
+	}
+
+private:
+	std::atomic<uint32_t> &m_lock;
+};
+
+template <typename T>
+static T *at(Header *header, Offset offset)
+{
+	return reinterpret_cast<T *>(reinterpret_cast<char *>(header) + offset);
+}
+
+static Size block_size_of(SizeClass szc)
+{
+	return MIN_BLOCK_SIZE << szc;
+}
+
+static SizeClass block_class(Size size)
+{
+	Size block = MIN_BLOCK_SIZE;
+
+	while (block < size)
+		block *= 2;
+
+	return ChunkMeta::get_sizeclass(block);
+}
+
+static SizeClass slab_class(Size size)
+{
+	SizeClass szc = 0;
+
+	while ((MIN_SLAB_SIZE << szc) < size)
+		szc++;
+
+	return szc;
+}
+
+static ChunkMeta &chunk_meta(Header *header, Offset offset)
+{
+	return header->meta[(offset - header->chunk_base) / CHUNK_SIZE];
+}
+
+static Offset chunk_offset(Header *header, Offset offset)
+{
+	return (offset - header->chunk_base) % CHUNK_SIZE;
+}
+
+static void push_block(Header *header, SizeClass szc, Offset offset)
+{
+	auto node = at<BlockNode>(header, offset);
+
+	node->prev = 0;
+	node->next = header->block_free[szc];
+
+	if (node->next)
+		at<BlockNode>(header, node->next)->prev = offset;
+
+	header->block_free[szc] = offset;
+}
+
+static void remove_block(Header *header, SizeClass szc, Offset offset)
+{
+	auto node = at<BlockNode>(header, offset);
+
+	if (node->prev)
+		at<BlockNode>(header, node->prev)->next = node->next;
+	else
+		header->block_free[szc] = node->next;
+
+	if (node->next)
+		at<BlockNode>(header, node->next)->prev = node->prev;
+}
+
+static Offset alloc_block(Header *header, SizeClass szc)
+{
+	if (szc == NUM_BLOCK_CLASSES)
+		return 0;
+
+	auto offset = header->block_free[szc];
+
+	if (offset)
+	{
+		remove_block(header, szc, offset);
+	}
+	else
+	{
+		if (!(offset = alloc_block(header, szc + 1)))
+			return 0;
+
+		push_block(header, szc, offset + block_size_of(szc));
+	}
+
+	chunk_meta(header, offset).mark_block_as_in_use(chunk_offset(header, offset), szc);
+	return offset;
+}
+
+static void free_block(Header *header, Offset offset, SizeClass szc)
+{
+	auto &meta = chunk_meta(header, offset);
+	auto in_chunk = chunk_offset(header, offset);
+
+	meta.mark_block_as_free(in_chunk, szc);
+
+	if (szc == NUM_BLOCK_CLASSES - 1)
+	{
+		push_block(header, szc, offset);
+		return;
+	}
+
+	auto buddy_in_chunk = ChunkMeta::get_buddy(in_chunk, szc);
+
+	if (meta.block_is_free(buddy_in_chunk, szc))
+	{
+		auto buddy = offset - in_chunk + buddy_in_chunk;
+
+		remove_block(header, szc, buddy);
+		free_block(header, std::min(offset, buddy), szc + 1);
+	}
+	else
+	{
+		push_block(header, szc, offset);
+	}
+}
+
+static void reclaim_remote_blocks(Header *header)
+{
+	auto offset = header->remote_block.exchange(0, std::memory_order_acquire);
+
+	while (offset)
+	{
+		auto block = at<RemoteBlock>(header, offset);
+		auto next = block->next;
+
+		free_block(header, offset, block->szc);
+		offset = next;
+	}
+}
+
+static Offset first_slab_object(Size object_size)
+{
+	return (sizeof(SlabPage) + object_size - 1) / object_size * object_size;
+}
+
+static void mark_slab_object(Header *header, Offset offset, bool in_use)
+{
+	auto page_offset = offset - (offset - header->chunk_base) % SLAB_PAGE_SIZE;
+	auto page = at<SlabPage>(header, page_offset);
+	auto index = (offset - page_offset) / page->object_size;
+	auto mask = uint64_t(1) << (index % 64);
+
+	if (in_use)
+		page->in_use[index / 64] |= mask;
+	else
+		page->in_use[index / 64] &= ~mask;
+}
+
+static void push_slab(Header *header, SizeClass szc, Offset offset)
+{
+	mark_slab_object(header, offset, false);
+	*at<Offset>(header, offset) = header->slab_free[szc];
+	header->slab_free[szc] = offset;
+}
+
+static void reclaim_remote_slab(Header *header, SizeClass szc)
+{
+	auto offset = header->remote_slab[szc].exchange(0, std::memory_order_acquire);
+
+	while (offset)
+	{
+		auto next = *at<Offset>(header, offset);
+
+		push_slab(header, szc, offset);
+		offset = next;
+	}
+}
+
+// Slab pages are carved into one free list per class and stay with it for good.
+static Offset alloc_slab(Header *header, SizeClass szc)
+{
+	if (!header->slab_free[szc])
+		reclaim_remote_slab(header, szc);
+
+	auto offset = header->slab_free[szc];
+
+	if (!offset)
+	{
+		auto page = alloc_block(header, block_class(SLAB_PAGE_SIZE));
+		auto object_size = MIN_SLAB_SIZE << szc;
+		Offset page_end = page + SLAB_PAGE_SIZE;
+
+		if (!page)
+			return 0;
+
+		auto slab_page = new (at<SlabPage>(header, page)) SlabPage{};
+
+		slab_page->object_size = object_size;
+		slab_page->next_page = header->slab_pages[szc];
+		header->slab_pages[szc] = page;
+		offset = page + first_slab_object(object_size);
+
+		for (auto object = offset; object < page_end; object += object_size)
+			*at<Offset>(header, object) = object + object_size;
+
+		*at<Offset>(header, page_end - object_size) = 0;
+	}
+
+	header->slab_free[szc] = *at<Offset>(header, offset);
+	mark_slab_object(header, offset, true);
+
+	return offset;
+}
+
+// A block whose own bit is set has either been split, leaving a child in use, or was handed out
+// whole, in which case all its descendants are clear.
+static void rebuild_blocks(Header *header, ChunkMeta &meta, Offset chunk, Offset in_chunk,
+						   SizeClass szc)
+{
+	if (meta.block_is_free(in_chunk, szc))
+	{
+		push_block(header, szc, chunk + in_chunk);
+		return;
+	}
+
+	if (szc == 0)
+		return;
+
+	auto upper = in_chunk + block_size_of(szc - 1);
+
+	if (meta.block_is_free(in_chunk, szc - 1) && meta.block_is_free(upper, szc - 1))
+		return;
+
+	rebuild_blocks(header, meta, chunk, in_chunk, szc - 1);
+	rebuild_blocks(header, meta, chunk, upper, szc - 1);
+}
+
+static void rebuild_slabs(Header *header, SizeClass szc)
+{
+	header->slab_free[szc] = 0;
+
+	for (auto page = header->slab_pages[szc]; page; page = at<SlabPage>(header, page)->next_page)
+	{
+		auto slab_page = at<SlabPage>(header, page);
+		auto object_size = slab_page->object_size;
+
+		for (auto index = first_slab_object(object_size) / object_size;
+			 index < SLAB_PAGE_SIZE / object_size; index++)
+		{
+			if (!(slab_page->in_use[index / 64] & (uint64_t(1) << (index % 64))))
+				push_slab(header, szc, page + index * object_size);
+		}
+	}
+}
+
+static void push_remote(Header *header, std::atomic<Offset> &head, Offset offset)
+{
+	auto next = at<Offset>(header, offset);
+
+	*next = head.load(std::memory_order_relaxed);
+
+	while (!head.compare_exchange_weak(*next, offset, std::memory_order_release,
+									   std::memory_order_relaxed))
+		;
+}
+
+SharedHeap::SharedHeap(void *mapping, size_t size) : m_header(nullptr)
+{
+	format(mapping, size);
+}
+
+SharedHeap::SharedHeap(void *mapping) : m_header(nullptr)
+{
+	attach(mapping);
+}
+
+void SharedHeap::format(void *mapping, size_t size)
+{
+	auto layout_size = [](Count chunk_count)
+	{
+		auto header_size = sizeof(Header) + chunk_count * sizeof(ChunkMeta);
+		return (header_size + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE * MIN_BLOCK_SIZE;
+	};
+
+	if (size < layout_size(1) + CHUNK_SIZE)
+		return;
+
+	Count chunk_count = (size - sizeof(Header)) / (CHUNK_SIZE + sizeof(ChunkMeta));
+
+	while (layout_size(chunk_count) + chunk_count * CHUNK_SIZE > size)
+		chunk_count--;
+
+	auto header = new (mapping) Header{};
+
+	header->size = size;
+	header->chunk_count = chunk_count;
+	header->chunk_base = layout_size(chunk_count);
+
+	for (Count i = 0; i < chunk_count; i++)
+	{
+		new (&header->meta[i]) ChunkMeta();
+		push_block(header, NUM_BLOCK_CLASSES - 1, header->chunk_base + i * CHUNK_SIZE);
+	}
+
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = SHARED_HEAP_MAGIC;
+	m_header = header;
+}
+
+void SharedHeap::attach(void *mapping)
+{
+	auto header = static_cast<Header *>(mapping);
+
+	if (header->magic == SHARED_HEAP_MAGIC)
+		m_header = header;
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+// The free lists live in the freed memory itself and may be half updated if a user died holding
+// the lock, so they are rebuilt from the buddy bitmaps and slab page headers alone.
+void SharedHeap::recover()
+{
+	m_header->lock.store(0, std::memory_order_relaxed);
+
+	for (auto &head : m_header->block_free)
+		head = 0;
+
+	for (Count i = 0; i < m_header->chunk_count; i++)
+	{
+		rebuild_blocks(m_header, m_header->meta[i], m_header->chunk_base + i * CHUNK_SIZE, 0,
+					   NUM_BLOCK_CLASSES - 1);
+	}
+
+	reclaim_remote_blocks(m_header);
+
+	for (SizeClass szc = 0; szc < NUM_SHARED_SLAB_CLASSES; szc++)
+	{
+		rebuild_slabs(m_header, szc);
+		reclaim_remote_slab(m_header, szc);
+	}
+}
+
+bool SharedHeap::is_valid() const
+{
+	return m_header != nullptr;
+}
+
+void *SharedHeap::alloc(size_t size)
+{
+	Offset offset;
+
+	if (size > CHUNK_SIZE)
+		return nullptr;
+
+	{
+		SharedLockGuard guard(m_header->lock);
+
+		if (m_header->remote_block.load(std::memory_order_relaxed))
+			reclaim_remote_blocks(m_header);
+
+		if (size <= MAX_SLAB_SIZE)
+			offset = alloc_slab(m_header, slab_class(size));
+		else
+			offset = alloc_block(m_header, block_class(size));
+	}
+
+	return offset ? from_offset(offset) : nullptr;
+}
+
+void SharedHeap::free(void *ptr, size_t size)
+{
+	auto offset = to_offset(ptr);
+	SharedLockGuard guard(m_header->lock);
+
+	if (size <= MAX_SLAB_SIZE)
+		push_slab(m_header, slab_class(size), offset);
+	else
+		free_block(m_header, offset, block_class(size));
+}
+
+void SharedHeap::remote_free(void *ptr, size_t size)
+{
+	auto offset = to_offset(ptr);
+
+	if (size <= MAX_SLAB_SIZE)
+	{
+		push_remote(m_header, m_header->remote_slab[slab_class(size)], offset);
+	}
+	else
+	{
+		at<RemoteBlock>(m_header, offset)->szc = block_class(size);
+		push_remote(m_header, m_header->remote_block, offset);
+	}
+}
+
+Offset SharedHeap::to_offset(const void *ptr) const
+{
+	return static_cast<const char *>(ptr) - reinterpret_cast<const char *>(m_header);
+}
+
+void *SharedHeap::from_offset(Offset offset) const
+{
+	return reinterpret_cast<char *>(m_header) + offset;
+}
+
+void SharedHeap::set_root(void *ptr)
+{
+	m_header->root = ptr ? to_offset(ptr) : 0;
+}
+
+void *SharedHeap::get_root() const
+{
+	return m_header->root ? from_offset(m_header->root) : nullptr;
+}
+
+size_t SharedHeap::capacity() const
+{
+	return m_header->chunk_count * CHUNK_SIZE;
+}
+
+}
@@ -9,6 +9,7 @@
 #include "SlabAllocator.h"
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 using namespace SmallAlloc::SlabAllocator;
@@ -35,21 +36,54 @@ struct SlabPageNode
 	SlabPageList::Node list_node;
 };
 
+static_assert(sizeof(SlabPageNode) == SlabAllocator::CACHE_LINE_SIZE,
+			  "Slab objects must not share a cache line with the page header");
+
 #define FREE_NODE_PTR_FROM_PAGE(p) reinterpret_cast<SlabPageList::Node *>(reinterpret_cast<char *>(p) + \
 																			sizeof(SlabPageHeader))
-#define PAGE_PTR_FROM_FREE_NODE(p) SLAB_HEADER(reinterpret_cast<char *>(p) - sizeof(SlabPageList::Node))
+#define PAGE_PTR_FROM_FREE_NODE(p) SLAB_HEADER(reinterpret_cast<char *>(p) - sizeof(SlabPageHeader))
+
+SlabAllocator::SlabAllocator(uint32_t alloc_size, uint32_t page_size,
+							 AlignedAlloc aligned_alloc_page, Free free_page, Size color_step)
+	: SlabAllocator(alloc_size, page_size, [aligned_alloc_page](Size align, Size size, bool &)
+	{
+		return aligned_alloc_page(align, size);
+	}, std::move(free_page), color_step)
+{}
 
 SlabAllocator::SlabAllocator(uint32_t alloc_size, uint32_t page_size,
-							 AlignedAlloc aligned_alloc_page, Free free_page)
-	: m_aligned_alloc_page(aligned_alloc_page), m_free_page(free_page),
+							 AlignedAllocZeroed aligned_alloc_page, Free free_page, Size color_step)
+	: m_aligned_alloc_page(std::move(aligned_alloc_page)), m_free_page(std::move(free_page)),
 	  m_alloc_size(alloc_size), m_page_size(page_size),
 	  m_max_alloc_count((page_size - sizeof(SlabPageNode)) / alloc_size),
-	  m_first_page(nullptr), m_freelist(), m_fullpages_list(), m_remote_freelist()
+	  m_occupancy_scale((NUM_OCCUPANCY_BINS << 16) / m_max_alloc_count),
+	  m_reciprocal(reciprocal_of(alloc_size)), m_color_step(color_step),
+	  m_color_limit(page_size - sizeof(SlabPageNode) - m_max_alloc_count * alloc_size),
+	  m_first_page(nullptr), m_partial_pages(), m_remote_freelist()
 {}
 
-SlabAllocator::SlabPageHeader *SlabAllocator::get_page(void *ptr)
+SlabAllocator::SlabAllocator(uint32_t object_size, uint32_t page_size, AlignedAlloc aligned_alloc_page,
+							 Free free_page, ObjectCallback constructor, ObjectCallback destructor,
+							 Size color_step)
+	: SlabAllocator(object_stride(object_size), page_size, std::move(aligned_alloc_page),
+					std::move(free_page), color_step)
+{
+	m_link_offset = link_offset(object_size);
+	m_constructor = std::move(constructor);
+	m_destructor = std::move(destructor);
+}
+
+SlabAllocator::~SlabAllocator()
 {
-	return SLAB_HEADER(INT_TO_PTR(PTR_TO_INT(ptr) - (PTR_TO_INT(ptr) & (m_page_size - 1))));
+	// Only an empty first page is certain to hold no live objects; the rest stay with the page
+	// allocator's owner as before.
+	if (m_constructor && m_first_page && m_first_page->is_page_empty())
+		free_page(m_first_page);
+}
+
+SmallAlloc::Count SlabAllocator::occupancy_bin(Count used_count)
+{
+	return (used_count * m_occupancy_scale) >> 16;
 }
 
 SmallAlloc::Size SlabAllocator::size()
@@ -59,18 +93,52 @@ SmallAlloc::Size SlabAllocator::size()
 
 void SlabAllocator::remote_free(void *ptr)
 {
-	m_remote_freelist.push(FREE_NODE(ptr));
+	m_remote_freelist.push(FREE_NODE(VOID_PTR(static_cast<char *>(ptr) + m_link_offset)));
+}
+
+// The objects between first and last must already be chained through their link words.
+void SlabAllocator::remote_free(void *first, void *last)
+{
+	m_remote_freelist.push(FREE_NODE(VOID_PTR(static_cast<char *>(first) + m_link_offset)),
+						   FREE_NODE(VOID_PTR(static_cast<char *>(last) + m_link_offset)));
 }
 
 SlabAllocator::SlabPageHeader *SlabAllocator::alloc_page()
 {
-	auto page = m_aligned_alloc_page(m_page_size, m_page_size);
+	bool zeroed = false;
+	auto page = m_aligned_alloc_page(m_page_size, m_page_size, zeroed);
 
 	if (!page)
 		return nullptr;
 
+	auto color = m_next_color;
+
+	if (m_color_step)
+	{
+		m_next_color += m_color_step;
+
+		if (m_next_color > m_color_limit)
+			m_next_color = 0;
+	}
+
 	m_page_count++;
-	return SlabPageHeader::build(page, m_alloc_size, m_max_alloc_count);
+
+	auto header = SlabPageHeader::build(page, m_alloc_size, m_max_alloc_count, m_reciprocal, color,
+										m_link_offset, zeroed);
+
+	if (m_constructor)
+		header->populate(m_constructor);
+
+	return header;
+}
+
+void SlabAllocator::free_page(SlabPageHeader *page)
+{
+	if (m_destructor)
+		page->depopulate(m_destructor);
+
+	m_free_page(page, m_page_size);
+	m_page_count--;
 }
 
 void *SlabAllocator::alloc_from_first_page()
@@ -81,7 +149,7 @@ void *SlabAllocator::alloc_from_first_page()
 
 	if (m_first_page->is_page_full())
 	{
-		m_fullpages_list.push_back(FREE_NODE_PTR_FROM_PAGE(m_first_page));
+		m_first_page->mark_page_full();
 		m_first_page = nullptr;
 	}
 
@@ -100,57 +168,106 @@ void *SlabAllocator::alloc_from_new_page()
 void *SlabAllocator::alloc()
 {
 	if (m_first_page)
-	{
 		return alloc_from_first_page();
 
-		if (reclaim_remote_free())
-			return alloc_from_first_page();
-	}
+	if (!m_remote_freelist.empty() && reclaim_remote_free())
+		return alloc_from_first_page();
 
-	if (!m_freelist.empty())
+	for (auto bin = NUM_OCCUPANCY_BINS; bin-- > 0;)
 	{
-		m_first_page = PAGE_PTR_FROM_FREE_NODE(m_freelist.pop_front());
-		return alloc_from_first_page();
+		if (!m_partial_pages[bin].empty())
+		{
+			m_first_page = PAGE_PTR_FROM_FREE_NODE(m_partial_pages[bin].pop_front());
+			return alloc_from_first_page();
+		}
 	}
 
 	return alloc_from_new_page();
 }
 
+void *SlabAllocator::calloc()
+{
+	auto ptr = alloc();
+
+	if (!ptr)
+		return nullptr;
+
+	if (get_page(ptr)->is_page_zeroed())
+		FREE_NODE(ptr)->next = nullptr;
+	else
+		memset(ptr, 0, m_alloc_size);
+
+	return ptr;
+}
+
 void SlabAllocator::free(void *ptr)
 {
 	auto page = get_page(ptr);
+	auto page_node = FREE_NODE_PTR_FROM_PAGE(page);
 
 	page->free(ptr);
 
-	if (page->was_page_full())
+	if (page == m_first_page)
+		return;
+
+	if (page->clear_page_full())
 	{
-		assert(page != m_first_page);
+		m_partial_pages[occupancy_bin(page->used_count())].push_back(page_node);
+	}
+	else if (page->is_page_empty())
+	{
+		SlabPageList::remove(page_node);
 
-		m_fullpages_list.remove(FREE_NODE_PTR_FROM_PAGE(page));
-		m_freelist.push_back(FREE_NODE_PTR_FROM_PAGE(page));
+		if (m_first_page)
+			free_page(page);
+		else
+		{
+			m_first_page = page;
+		}
 	}
 	else
 	{
-		if (page->is_page_empty())
+		auto bin = occupancy_bin(page->used_count());
+
+		if (bin != occupancy_bin(page->used_count() + 1))
 		{
-			if (page != m_first_page)
-			{
-				m_freelist.remove(FREE_NODE_PTR_FROM_PAGE(page));
-
-				if (m_page_count)
-				{
-					m_free_page(page, m_page_size);
-					m_page_count--;
-				}
-				else
-				{
-					m_freelist.push_front(FREE_NODE_PTR_FROM_PAGE(page));
-				}
-			}
+			SlabPageList::remove(page_node);
+			m_partial_pages[bin].push_back(page_node);
 		}
 	}
 }
 
+// Carves fresh pages until count objects fit in the slots already free, so allocating them never
+// waits on the page allocator. Carving writes every slot's link, which also faults the pages in.
+bool SlabAllocator::reserve(Count count)
+{
+	Count free_count = m_first_page ? m_max_alloc_count - m_first_page->used_count() : 0;
+
+	for (auto &partial_pages : m_partial_pages)
+	{
+		for (auto node = partial_pages.front(); node != partial_pages.end(); node = node->get_next())
+			free_count += m_max_alloc_count - PAGE_PTR_FROM_FREE_NODE(node)->used_count();
+	}
+
+	for (; free_count < count; free_count += m_max_alloc_count)
+	{
+		auto page = alloc_page();
+
+		if (!page)
+			return false;
+
+		if (!m_constructor)
+			page->carve();
+
+		if (m_first_page)
+			m_partial_pages[0].push_back(FREE_NODE_PTR_FROM_PAGE(page));
+		else
+			m_first_page = page;
+	}
+
+	return true;
+}
+
 bool SlabAllocator::reclaim_remote_free()
 {
 	auto free_node = m_remote_freelist.popAll();
@@ -160,7 +277,7 @@ bool SlabAllocator::reclaim_remote_free()
 
 	do
 	{
-		auto ptr = VOID_PTR(free_node);
+		auto ptr = VOID_PTR(reinterpret_cast<char *>(free_node) - m_link_offset);
 		free_node = free_node->get_next();
 		free(ptr);
 	}
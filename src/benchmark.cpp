@@ -6,12 +6,20 @@
  */
 
 
+#include "Allocator.h"
+#include "Arena.h"
 #include "Heap.h"
+#include "ObjectPool.h"
+#include "SlabAllocator.h"
 #include "rpmalloc/rpmalloc.h"
 #include "BenchMark.h"
 
+#include <list>
+#include <map>
 #include <random>
+#include <thread>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include <chrono>
 #include <ctime>
@@ -196,6 +204,358 @@ static void BM_SMalloc(benchmark::State& state, AllocatorType allocator,
 	rpmalloc_finalize();
 }
 
+template <bool UseReciprocal>
+static void BM_ObjectIndex(benchmark::State& state)
+{
+	constexpr size_t PageSize = 256 * 1024;
+	const uint32_t object_size = state.range(0);
+	const uint32_t reciprocal = SmallAlloc::SlabAllocator::SlabAllocator::reciprocal_of(object_size);
+
+	std::mt19937 rnd(object_size);
+	std::vector<uint32_t> offsets(4096);
+
+	for (auto &offset : offsets)
+		offset = (rnd() % (PageSize / object_size)) * object_size;
+
+	for (auto _ : state)
+	{
+		uint64_t index_sum = 0;
+
+		for (auto offset : offsets)
+		{
+			if (UseReciprocal)
+				index_sum += (static_cast<uint64_t>(offset) * reciprocal) >> 32;
+			else
+				index_sum += offset / object_size;
+		}
+
+		benchmark::DoNotOptimize(index_sum);
+	}
+
+	state.SetItemsProcessed(state.iterations() * offsets.size());
+}
+
+static void BM_SlabColoring(benchmark::State& state, SmallAlloc::Size color_step)
+{
+	using namespace SmallAlloc;
+
+	constexpr uint32_t ObjectSize = 7120;
+	constexpr uint32_t PageSize = 256 * 1024;
+	constexpr uint32_t TouchSize = 128;
+	constexpr int PageCount = 128;
+
+	SlabAllocator::SlabAllocator slab{ObjectSize, PageSize, [](Size align, Size size)
+	{
+		void *page = nullptr;
+		posix_memalign(&page, align, size);
+		return page;
+	}, [](void *page, Size)
+	{
+		free(page);
+	}, color_step};
+
+	std::vector<void *> objects;
+	std::vector<char *> first_objects;
+	uintptr_t last_page = 0;
+
+	while (first_objects.size() < PageCount)
+	{
+		auto obj = slab.alloc();
+		auto page = reinterpret_cast<uintptr_t>(obj) & ~uintptr_t{PageSize - 1};
+
+		if (page != last_page)
+			first_objects.push_back(static_cast<char *>(obj));
+
+		last_page = page;
+		objects.push_back(obj);
+	}
+
+	for (auto _ : state)
+	{
+		for (auto obj : first_objects)
+		{
+			for (uint32_t offset = 0; offset < TouchSize; offset += 64)
+				++*reinterpret_cast<volatile uint64_t *>(obj + offset);
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * PageCount);
+
+	for (auto obj : objects)
+		slab.free(obj);
+}
+
+static void BM_FalseSharing(benchmark::State& state, bool cacheline_isolated)
+{
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr int ThreadCount = 4;
+	constexpr int IncrementCount = 1024 * 1024;
+
+	SmallAlloc::Heap heap(AllocLimit);
+
+	for (auto _ : state)
+	{
+		uint64_t *counters[ThreadCount];
+		std::vector<std::thread> workers;
+
+		for (auto &counter : counters)
+		{
+			auto mem = cacheline_isolated ? heap.alloc_cacheline(sizeof(uint64_t)) :
+					   heap.alloc(sizeof(uint64_t));
+			counter = static_cast<uint64_t *>(mem);
+		}
+
+		for (auto counter : counters)
+		{
+			workers.push_back(std::thread([counter]()
+			{
+				for (int i = 0; i < IncrementCount; i++)
+					++*reinterpret_cast<volatile uint64_t *>(counter);
+			}));
+		}
+
+		for (auto &worker : workers)
+			worker.join();
+
+		for (auto counter : counters)
+		{
+			if (cacheline_isolated)
+				heap.free_cacheline(counter, sizeof(uint64_t));
+			else
+				heap.free(counter, sizeof(uint64_t));
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * ThreadCount * IncrementCount);
+}
+
+static void BM_ChurnFootprint(benchmark::State& state)
+{
+	using namespace SmallAlloc;
+
+	constexpr uint32_t ObjectSize = 256;
+	constexpr uint32_t PageSize = 8 * 1024;
+	constexpr int RoundSize = 1024;
+	constexpr int PhaseLength = 256;
+	constexpr size_t MaxLiveCount = 256 * 1024;
+
+	SlabAllocator::SlabAllocator slab{ObjectSize, PageSize, [](Size align, Size size)
+	{
+		void *page = nullptr;
+		posix_memalign(&page, align, size);
+		return page;
+	}, [](void *page, Size)
+	{
+		free(page);
+	}};
+
+	std::mt19937_64 rnd(42);
+	std::vector<void *> live;
+	size_t round = 0, footprint_sum = 0, live_sum = 0;
+
+	auto free_one = [&]()
+	{
+		auto ind = rnd() % live.size();
+		slab.free(live[ind]);
+		live[ind] = live.back();
+		live.pop_back();
+	};
+
+	live.reserve(MaxLiveCount);
+
+	for (auto _ : state)
+	{
+		bool growing = (round++ / PhaseLength) % 2 == 0;
+
+		for (int i = 0; i < RoundSize; i++)
+		{
+			if (growing && live.size() < MaxLiveCount)
+			{
+				live.push_back(slab.alloc());
+
+				if (i % 2)
+					free_one();
+			}
+			else if (!live.empty())
+			{
+				free_one();
+
+				if (i % 4 == 0)
+					live.push_back(slab.alloc());
+			}
+		}
+
+		footprint_sum += slab.size();
+		live_sum += live.size() * ObjectSize;
+	}
+
+	for (auto obj : live)
+		slab.free(obj);
+
+	state.counters["AvgFootprintMB"] = footprint_sum / double(round) / (1024 * 1024);
+	state.counters["AvgLiveMB"] = live_sum / double(round) / (1024 * 1024);
+}
+
+static void BM_HeapFirstAlloc(benchmark::State& state)
+{
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t AllocSize = 64;
+
+	for (auto _ : state)
+	{
+		std::thread worker([]()
+		{
+			SmallAlloc::Heap heap(AllocLimit);
+			auto ptr = heap.alloc(AllocSize);
+
+			benchmark::DoNotOptimize(ptr);
+			heap.free(ptr, AllocSize);
+		});
+
+		worker.join();
+	}
+}
+
+static void BM_HeapAllocFree(benchmark::State& state)
+{
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr int BatchSize = 64;
+
+	SmallAlloc::Heap heap(AllocLimit);
+	size_t alloc_size = state.range(0);
+	void *ptrs[BatchSize];
+
+	for (auto _ : state)
+	{
+		for (auto &ptr : ptrs)
+			ptr = heap.alloc(alloc_size);
+
+		benchmark::DoNotOptimize(ptrs);
+
+		for (auto ptr : ptrs)
+			heap.free(ptr, alloc_size);
+	}
+
+	state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+template <size_t NodeSize>
+static void BM_ObjectPoolAllocFree(benchmark::State& state)
+{
+	struct Node
+	{
+		char payload[NodeSize];
+	};
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr int BatchSize = 64;
+
+	SmallAlloc::Heap heap(AllocLimit);
+	SmallAlloc::ObjectPool<Node> pool(heap);
+	void *nodes[BatchSize];
+
+	for (auto _ : state)
+	{
+		for (auto &node : nodes)
+			node = pool.alloc();
+
+		benchmark::DoNotOptimize(nodes);
+
+		for (auto node : nodes)
+			pool.free(node);
+	}
+
+	state.SetItemsProcessed(state.iterations() * BatchSize);
+}
+
+// Allocates a request's worth of temporaries and tears them all down.
+static void BM_RequestTeardown(benchmark::State& state, bool use_arena)
+{
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr int TempsPerRequest = 4096;
+
+	SmallAlloc::Heap heap(AllocLimit);
+	SmallAlloc::Arena arena(heap);
+	std::vector<std::pair<void *, size_t>> temps(TempsPerRequest);
+
+	for (auto _ : state)
+	{
+		for (int i = 0; i < TempsPerRequest; i++)
+		{
+			size_t size = 16 + (i * 7919) % 240;
+
+			temps[i] = {use_arena ? arena.alloc(size) : heap.alloc(size), size};
+		}
+
+		benchmark::DoNotOptimize(temps.data());
+
+		if (use_arena)
+		{
+			arena.reset();
+		}
+		else
+		{
+			for (auto &temp : temps)
+				heap.free(temp.first, temp.second);
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * TempsPerRequest);
+}
+
+template <template <typename> class Alloc>
+static void BM_MapInsert(benchmark::State& state)
+{
+	using Map = std::map<int, int, std::less<int>, Alloc<std::pair<const int, int>>>;
+
+	for (auto _ : state)
+	{
+		Map map;
+
+		for (int i = 0; i < state.range(0); i++)
+			map[i * 7919 % state.range(0)] = i;
+
+		benchmark::DoNotOptimize(map.size());
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <template <typename> class Alloc>
+static void BM_UnorderedMapInsert(benchmark::State& state)
+{
+	using Map = std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+		  Alloc<std::pair<const int, int>>>;
+
+	for (auto _ : state)
+	{
+		Map map;
+
+		for (int i = 0; i < state.range(0); i++)
+			map[i] = i;
+
+		benchmark::DoNotOptimize(map.size());
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <template <typename> class Alloc>
+static void BM_ListInsert(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		std::list<int, Alloc<int>> list;
+
+		for (int i = 0; i < state.range(0); i++)
+			list.push_back(i);
+
+		benchmark::DoNotOptimize(list.size());
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
 static void generate_bench_args(std::vector<int> &op_vec, std::vector<size_t> &alloc_size_vec,
 								std::vector<int> &free_ind_vec, std::vector<int> &unfreed_ind_vec,
 								int num_operations)
@@ -282,6 +642,40 @@ int main(int argc, char** argv)
 	benchmark::RegisterBenchmark("JeMallocTest", BM_SMalloc, JEMALLOC_ALLOCATOR, op_vec,
 								 alloc_size_vec, free_ind_vec, unfreed_ind_vec);
 
+	benchmark::RegisterBenchmark("ObjectIndexDivide", BM_ObjectIndex<false>)
+	->Arg(1000)->Arg(2808)->Arg(7120);
+	benchmark::RegisterBenchmark("ObjectIndexReciprocal", BM_ObjectIndex<true>)
+	->Arg(1000)->Arg(2808)->Arg(7120);
+
+	benchmark::RegisterBenchmark("SlabScratchNoColoring", BM_SlabColoring, 0);
+	benchmark::RegisterBenchmark("SlabScratchColoring", BM_SlabColoring,
+								 SmallAlloc::SlabAllocator::SlabAllocator::CACHE_LINE_SIZE);
+
+	benchmark::RegisterBenchmark("CacheThrashShared", BM_FalseSharing, false)->UseRealTime();
+	benchmark::RegisterBenchmark("CacheThrashIsolated", BM_FalseSharing, true)->UseRealTime();
+
+	benchmark::RegisterBenchmark("ChurnFootprint", BM_ChurnFootprint)->Iterations(4 * 1024);
+
+	benchmark::RegisterBenchmark("HeapFirstAlloc", BM_HeapFirstAlloc)->UseRealTime();
+	benchmark::RegisterBenchmark("HeapAllocFree", BM_HeapAllocFree)->Arg(16)->Arg(64)->Arg(256);
+	benchmark::RegisterBenchmark("ObjectPoolAllocFree/16", BM_ObjectPoolAllocFree<16>);
+	benchmark::RegisterBenchmark("ObjectPoolAllocFree/64", BM_ObjectPoolAllocFree<64>);
+	benchmark::RegisterBenchmark("ObjectPoolAllocFree/256", BM_ObjectPoolAllocFree<256>);
+
+	benchmark::RegisterBenchmark("RequestTeardownHeap", BM_RequestTeardown, false);
+	benchmark::RegisterBenchmark("RequestTeardownArena", BM_RequestTeardown, true);
+
+	benchmark::RegisterBenchmark("MapStdAllocator", BM_MapInsert<std::allocator>)->Arg(64 * 1024);
+	benchmark::RegisterBenchmark("MapSmallAllocator", BM_MapInsert<SmallAlloc::Allocator>)
+	->Arg(64 * 1024);
+	benchmark::RegisterBenchmark("UnorderedMapStdAllocator", BM_UnorderedMapInsert<std::allocator>)
+	->Arg(64 * 1024);
+	benchmark::RegisterBenchmark("UnorderedMapSmallAllocator",
+								 BM_UnorderedMapInsert<SmallAlloc::Allocator>)->Arg(64 * 1024);
+	benchmark::RegisterBenchmark("ListStdAllocator", BM_ListInsert<std::allocator>)->Arg(64 * 1024);
+	benchmark::RegisterBenchmark("ListSmallAllocator", BM_ListInsert<SmallAlloc::Allocator>)
+	->Arg(64 * 1024);
+
 	benchmark::Initialize(&argc, argv);
 	benchmark::RunSpecifiedBenchmarks();
 }
@@ -0,0 +1,255 @@
+/**
+ * File: /testAllocator.cpp
+ * Project: test
+ * Created Date: Monday, October 19th 2026, 2:31:48 pm
+ * Author: Harikrishnan
+ */
+
+
+#include "Allocator.h"
+#include "ObjectPool.h"
+#include "test/catch.hpp"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+TEST_CASE("AllocatorTest", "[allocator]")
+{
+	using namespace std;
+	using SmallAlloc::Allocator;
+
+	struct alignas(32) Vec8f
+	{
+		float lanes[8];
+	};
+
+	constexpr int ElementCount = 16 * 1024;
+
+	map<int, int, less<int>, Allocator<pair<const int, int>>> ordered;
+	unordered_map<int, int, hash<int>, equal_to<int>, Allocator<pair<const int, int>>> hashed;
+	list<int, Allocator<int>> linked;
+	vector<Vec8f, Allocator<Vec8f>> vectors(ElementCount);
+
+	for (int i = 0; i < ElementCount; i++)
+	{
+		ordered[i] = i;
+		hashed[i] = i;
+		linked.push_back(i);
+	}
+
+	for (int i = 0; i < ElementCount; i++)
+	{
+		REQUIRE(ordered[i] == i);
+		REQUIRE(hashed[i] == i);
+	}
+
+	REQUIRE(linked.size() == ElementCount);
+	REQUIRE(reinterpret_cast<uintptr_t>(vectors.data()) % alignof(Vec8f) == 0);
+	REQUIRE(Allocator<int>() == Allocator<double>());
+}
+
+TEST_CASE("AllocatorCrossThreadTest", "[allocator]")
+{
+	using namespace std;
+	using SmallAlloc::Allocator;
+
+	using List = list<int, Allocator<int>>;
+
+	constexpr int ElementCount = 16 * 1024;
+	constexpr int Rounds = 16;
+
+	vector<unique_ptr<List>> lists(Rounds);
+	atomic<int> produced{0};
+	bool lists_intact = true;
+
+	// Lists are destroyed by the consumer while the producer keeps allocating from its own heap.
+	thread producer([&]()
+	{
+		for (int round = 0; round < Rounds; round++)
+		{
+			lists[round] = make_unique<List>();
+
+			for (int i = 0; i < ElementCount; i++)
+				lists[round]->push_back(i);
+
+			produced.store(round + 1, memory_order_release);
+		}
+	});
+
+	thread consumer([&]()
+	{
+		for (int round = 0; round < Rounds; round++)
+		{
+			while (produced.load(memory_order_acquire) == round)
+				this_thread::yield();
+
+			int expected = 0;
+
+			for (auto value : *lists[round])
+				lists_intact &= value == expected++;
+
+			lists_intact &= expected == ElementCount;
+			lists[round].reset();
+		}
+
+		SmallAlloc::Heap::flush_remote();
+	});
+
+	producer.join();
+	consumer.join();
+
+	REQUIRE(lists_intact);
+}
+
+TEST_CASE("MemoryResourceTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+
+	SmallAlloc::Heap heap(AllocLimit), other_heap(AllocLimit);
+	SmallAlloc::MemoryResource resource(heap), same_resource(heap), other_resource(other_heap);
+
+	REQUIRE(resource.is_equal(same_resource));
+	REQUIRE(!resource.is_equal(other_resource));
+	REQUIRE(!resource.is_equal(*pmr::new_delete_resource()));
+
+	{
+		pmr::vector<pmr::string> strings(&resource);
+
+		for (int i = 0; i < 4096; i++)
+			strings.emplace_back(to_string(i) + string(i % 200, 'x'));
+
+		for (int i = 0; i < 4096; i++)
+			REQUIRE(string_view(strings[i]) == to_string(i) + string(i % 200, 'x'));
+	}
+
+	for (size_t align = 1; align <= 4096; align *= 2)
+	{
+		auto mem = resource.allocate(align * 3, align);
+
+		REQUIRE(reinterpret_cast<uintptr_t>(mem) % align == 0);
+		resource.deallocate(mem, align * 3, align);
+	}
+}
+
+namespace
+{
+
+struct Node
+{
+	static int live;
+
+	Node *next;
+	int key;
+
+	Node(Node *next, int key) : next(next), key(key)
+	{
+		if (key < 0)
+			throw std::invalid_argument("negative key");
+
+		live++;
+	}
+
+	~Node()
+	{
+		live--;
+	}
+};
+
+int Node::live = 0;
+
+}
+
+TEST_CASE("ObjectPoolTest", "[allocator]")
+{
+	using namespace std;
+	using SmallAlloc::ObjectPool;
+
+	struct alignas(64) PaddedCounter
+	{
+		long value;
+	};
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr int NodeCount = 64 * 1024;
+
+	static_assert(SmallAlloc::sizeclass_to_allocsize[ObjectPool<Node>::SIZE_CLASS] == sizeof(Node));
+	static_assert(SmallAlloc::sizeclass_to_allocsize[ObjectPool<PaddedCounter>::SIZE_CLASS] % 64 == 0);
+
+	SmallAlloc::Heap heap(AllocLimit);
+	ObjectPool<Node> pool(heap);
+	ObjectPool<PaddedCounter> counter_pool(heap);
+	Node *head = nullptr;
+
+	for (int i = 0; i < NodeCount; i++)
+		head = pool.make(head, i);
+
+	REQUIRE(Node::live == NodeCount);
+	REQUIRE_THROWS_AS(pool.make(head, -1), const invalid_argument &);
+	REQUIRE(Node::live == NodeCount);
+
+	for (int i = NodeCount - 1; i >= 0; i--)
+	{
+		auto next = head->next;
+
+		REQUIRE(head->key == i);
+		pool.destroy(head);
+		head = next;
+	}
+
+	REQUIRE(Node::live == 0);
+
+	vector<PaddedCounter *> counters;
+
+	for (int i = 0; i < 1024; i++)
+	{
+		counters.push_back(counter_pool.make(PaddedCounter{i}));
+		REQUIRE(reinterpret_cast<uintptr_t>(counters.back()) % 64 == 0);
+	}
+
+	for (auto counter : counters)
+		counter_pool.destroy(counter);
+
+	// Pool memory is ordinary heap memory of the chosen size class.
+	auto node = pool.make(nullptr, 7);
+
+	node->~Node();
+	heap.free(node, sizeof(Node));
+}
+
+TEST_CASE("ThreadHeapTest", "[allocator]")
+{
+	constexpr size_t AllocSize = 64;
+	constexpr uintptr_t PageSize = 4096;
+
+	void *first_ptr = nullptr, *second_ptr = nullptr;
+	auto alloc_free = [](void *&ptr)
+	{
+		auto &heap = SmallAlloc::Heap::thread_heap();
+
+		ptr = heap.alloc(AllocSize);
+		heap.free(ptr, AllocSize);
+	};
+
+	REQUIRE(&SmallAlloc::Heap::thread_heap() == &SmallAlloc::Heap::thread_heap());
+
+	std::thread(alloc_free, std::ref(first_ptr)).join();
+	std::thread(alloc_free, std::ref(second_ptr)).join();
+
+	auto page_of = [](void *ptr)
+	{
+		return reinterpret_cast<uintptr_t>(ptr) & ~(PageSize - 1);
+	};
+
+	REQUIRE(first_ptr != nullptr);
+	REQUIRE(page_of(first_ptr) == page_of(second_ptr));
+}
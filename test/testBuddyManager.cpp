@@ -239,4 +239,45 @@ TEST_CASE("BuddyManager Test", "[allocator]")
 		  auto size) {});
 
 	REQUIRE(dummy_buddy_manager2.alloc(MinAllocSize) == nullptr);
-}
\ No newline at end of file
+}
+
+TEST_CASE("BuddyManager Resize Test", "[allocator]")
+{
+	using BuddyManager = SmallAlloc::BuddyManager::BuddyManager;
+	constexpr auto BuddyManagerAllocLimit = 4 * 1024 * 1024;
+
+	BuddyManager buddy_manager(BuddyManagerAllocLimit, [](auto align, auto size)
+	{
+		return test_aligned_alloc(align, size);
+	}, [](void *ptr, auto size)
+	{
+		test_aligned_free(ptr);
+	});
+
+	auto MinAllocSize = buddy_manager.get_min_alloc_size();
+	auto BigAllocSize = MinAllocSize * 16;
+
+	auto lower = static_cast<char *>(buddy_manager.alloc(MinAllocSize));
+	auto upper = static_cast<char *>(buddy_manager.alloc(MinAllocSize));
+
+	REQUIRE(upper == lower + MinAllocSize);
+	REQUIRE(!buddy_manager.resize(upper, MinAllocSize, MinAllocSize * 2));
+	REQUIRE(!buddy_manager.resize(lower, MinAllocSize, MinAllocSize * 2));
+
+	buddy_manager.free(upper, MinAllocSize);
+
+	REQUIRE(buddy_manager.resize(lower, MinAllocSize, MinAllocSize * 2));
+	REQUIRE(buddy_manager.resize(lower, MinAllocSize * 2, BigAllocSize));
+
+	auto other = static_cast<char *>(buddy_manager.alloc(MinAllocSize));
+
+	REQUIRE((other < lower || other >= lower + BigAllocSize));
+	REQUIRE(buddy_manager.resize(lower, BigAllocSize, MinAllocSize));
+	REQUIRE(buddy_manager.alloc(MinAllocSize) == lower + MinAllocSize);
+
+	buddy_manager.free(lower + MinAllocSize, MinAllocSize);
+	buddy_manager.free(other, MinAllocSize);
+	buddy_manager.free(lower, MinAllocSize);
+
+	REQUIRE(buddy_manager.alloc(buddy_manager.get_page_size()) == lower);
+}
@@ -7,13 +7,24 @@
 
 
 
+#include "Arena.h"
 #include "Heap.h"
 #include "test/catch.hpp"
 #include "test/testBase.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <random>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif // _WIN32
 #include <unordered_set>
 
 using random_gen = std::ranlux24_base;
@@ -57,7 +68,7 @@ TEST_CASE("HeapTest", "[allocator]")
 		return uniform_dist(rand_op);
 	};
 
-	constexpr auto MinAllocSize = 40, MaxAllocSize = 8144;
+	constexpr auto MinAllocSize = 8, MaxAllocSize = 8144;
 	random_gen rand_size(seed);
 	std::uniform_int_distribution<int> size_dist(MinAllocSize, MaxAllocSize);
 	auto gen_size = [&rand_size, &size_dist]()
@@ -120,4 +131,853 @@ TEST_CASE("HeapTest", "[allocator]")
 
 	for (auto mem : ptr_set)
 		heap.free(mem, *reinterpret_cast<size_t *>(mem));
-}
\ No newline at end of file
+}
+
+TEST_CASE("HeapRemoteFreeTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr int MaxThreads = 8;
+	constexpr int AllocCount = 16 * 1024;
+
+	std::random_device r;
+	std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+	random_gen rand_size(seed);
+	std::uniform_int_distribution<int> size_dist(8, 1024);
+
+	SmallAlloc::Heap heap(AllocLimit);
+	vector<pair<void *, size_t>> ptrs[MaxThreads];
+
+	for (int i = 0; i < AllocCount; i++)
+	{
+		size_t alloc_size = size_dist(rand_size);
+		auto mem = heap.alloc(alloc_size);
+
+		REQUIRE(mem != nullptr);
+		ptrs[i % MaxThreads].push_back({mem, alloc_size});
+	}
+
+	auto heap_size = heap.size();
+	vector<thread> workers;
+
+	for (int i = 0; i < MaxThreads; i++)
+	{
+		workers.push_back(thread([&heap](vector<pair<void *, size_t>> &thread_ptrs)
+		{
+			for (auto &ptr : thread_ptrs)
+				heap.remote_free(ptr.first, ptr.second);
+
+			if (thread_ptrs.size() % 2)
+				SmallAlloc::Heap::flush_remote();
+		}, std::ref(ptrs[i])));
+	}
+
+	for (auto &worker : workers)
+		worker.join();
+
+	unordered_set<void *> ptr_set;
+
+	for (auto &thread_ptrs : ptrs)
+	{
+		for (auto &ptr : thread_ptrs)
+		{
+			auto mem = heap.alloc(ptr.second);
+
+			REQUIRE(mem != nullptr);
+			REQUIRE(ptr_set.count(mem) == 0);
+			ptr_set.insert(mem);
+		}
+	}
+
+	REQUIRE(heap.size() <= heap_size);
+
+	// Buddy blocks and huge mappings freed from another thread go back to the heap that owns them.
+	vector<pair<void *, size_t>> large_ptrs;
+
+	for (size_t alloc_size : {10000, 64 * 1024, 1024 * 1024, 5 * 1024 * 1024})
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			auto mem = heap.alloc(alloc_size);
+
+			REQUIRE(mem != nullptr);
+			memset(mem, 0x7F, alloc_size);
+			large_ptrs.push_back({mem, alloc_size});
+		}
+	}
+
+	heap_size = heap.size();
+
+	thread([&]()
+	{
+		for (auto &ptr : large_ptrs)
+			heap.remote_free(ptr.first, ptr.second);
+	}).join();
+
+	REQUIRE(heap.size() < heap_size);
+
+	for (auto &ptr : large_ptrs)
+		REQUIRE(heap.alloc(ptr.second) != nullptr);
+
+	REQUIRE(heap.size() <= heap_size);
+}
+
+TEST_CASE("HeapRemoteFreeLifetimeTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t AllocSize = 64;
+	constexpr int FreeCount = 8;
+
+	SmallAlloc::Heap reset_heap(AllocLimit);
+	auto destroyed_heap = make_unique<SmallAlloc::Heap>(AllocLimit);
+	vector<void *> reset_ptrs, destroyed_ptrs;
+	atomic<int> stage{0};
+
+	for (int i = 0; i < FreeCount; i++)
+	{
+		reset_ptrs.push_back(reset_heap.alloc(AllocSize));
+		destroyed_ptrs.push_back(destroyed_heap->alloc(AllocSize));
+	}
+
+	// The worker's batches are still pending when one heap is reset and the other destroyed.
+	thread worker([&]()
+	{
+		for (int i = 0; i < FreeCount; i++)
+		{
+			reset_heap.remote_free(reset_ptrs[i], AllocSize);
+			destroyed_heap->remote_free(destroyed_ptrs[i], AllocSize);
+		}
+
+		stage = 1;
+
+		while (stage != 2)
+			this_thread::yield();
+
+		SmallAlloc::Heap::flush_remote();
+	});
+
+	while (stage != 1)
+		this_thread::yield();
+
+	reset_heap.reset();
+	destroyed_heap.reset();
+	stage = 2;
+	worker.join();
+
+	unordered_set<void *> ptr_set;
+
+	for (int i = 0; i < 2 * FreeCount; i++)
+	{
+		auto mem = reset_heap.alloc(AllocSize);
+
+		REQUIRE(mem != nullptr);
+		REQUIRE(ptr_set.count(mem) == 0);
+		ptr_set.insert(mem);
+	}
+}
+
+TEST_CASE("HeapCachelineTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t CacheLineSize = 64;
+
+	std::random_device r;
+	std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+	random_gen rand_size(seed);
+	std::uniform_int_distribution<int> size_dist(1, 8192);
+
+	SmallAlloc::Heap heap(AllocLimit);
+	vector<pair<void *, size_t>> ptrs;
+	unordered_set<uintptr_t> lines;
+
+	for (int i = 0; i < 16 * 1024; i++)
+	{
+		size_t alloc_size = size_dist(rand_size);
+		auto mem = heap.alloc_cacheline(alloc_size);
+
+		REQUIRE(mem != nullptr);
+		REQUIRE(reinterpret_cast<uintptr_t>(mem) % CacheLineSize == 0);
+
+		memset(mem, 0x7F, alloc_size);
+		ptrs.push_back({mem, alloc_size});
+	}
+
+	for (auto &ptr : ptrs)
+	{
+		auto first_line = reinterpret_cast<uintptr_t>(ptr.first) / CacheLineSize;
+		auto last_line = (reinterpret_cast<uintptr_t>(ptr.first) + ptr.second - 1) / CacheLineSize;
+
+		REQUIRE(lines.count(first_line) == 0);
+		REQUIRE(lines.count(last_line) == 0);
+		lines.insert(first_line);
+		lines.insert(last_line);
+	}
+
+	for (size_t i = 0; i < ptrs.size(); i++)
+	{
+		if (i % 2)
+			heap.free_cacheline(ptrs[i].first, ptrs[i].second);
+		else
+			heap.remote_free_cacheline(ptrs[i].first, ptrs[i].second);
+	}
+
+	SmallAlloc::Heap::flush_remote();
+
+	REQUIRE(heap.alloc_cacheline(0) == nullptr);
+	heap.free_cacheline(nullptr, 0);
+	heap.remote_free_cacheline(nullptr, 0);
+
+	// Sizes past the largest cache line class still come back cache line isolated.
+	for (size_t alloc_size : {size_t(8193), size_t(64 * 1024 + 1), size_t(5 * 1024 * 1024)})
+	{
+		auto mem = heap.alloc_cacheline(alloc_size);
+		auto remote_mem = heap.alloc_cacheline(alloc_size);
+
+		REQUIRE(mem != nullptr);
+		REQUIRE(remote_mem != nullptr);
+		REQUIRE(reinterpret_cast<uintptr_t>(mem) % CacheLineSize == 0);
+		REQUIRE(reinterpret_cast<uintptr_t>(remote_mem) % CacheLineSize == 0);
+
+		memset(mem, 0x7F, alloc_size);
+		memset(remote_mem, 0x7F, alloc_size);
+		heap.free_cacheline(mem, alloc_size);
+		heap.remote_free_cacheline(remote_mem, alloc_size);
+	}
+}
+
+TEST_CASE("HeapAlignedTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t Alignments[] = {1, 8, 16, 32, 64, 128, 4096, 64 * 1024};
+
+	std::random_device r;
+	std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+	random_gen rand_size(seed);
+	std::uniform_int_distribution<int> size_dist(1, 16 * 1024);
+
+	SmallAlloc::Heap heap(AllocLimit);
+	vector<tuple<void *, size_t, size_t>> ptrs;
+
+	REQUIRE(heap.alloc_aligned(64, 48) == nullptr);
+	REQUIRE(heap.alloc_aligned(64, 0) == nullptr);
+
+	for (int i = 0; i < 16 * 1024; i++)
+	{
+		size_t alloc_size = size_dist(rand_size);
+		size_t align = Alignments[i % size(Alignments)];
+		auto mem = heap.alloc_aligned(alloc_size, align);
+
+		REQUIRE(mem != nullptr);
+		REQUIRE(reinterpret_cast<uintptr_t>(mem) % align == 0);
+
+		memset(mem, 0x7F, alloc_size);
+		ptrs.push_back({mem, alloc_size, align});
+	}
+
+	for (auto &ptr : ptrs)
+		heap.free_aligned(get<0>(ptr), get<1>(ptr), get<2>(ptr));
+
+	// Alignments past a chunk and allocations larger than one.
+	for (auto [alloc_size, align] : {pair<size_t, size_t>{5 * 1024 * 1024, 64 * 1024},
+			 {8 * 1024 * 1024, 4 * 1024 * 1024}, {4096, 8 * 1024 * 1024}, {5 * 1024 * 1024, 16 * 1024 * 1024}})
+	{
+		auto mem = heap.alloc_aligned(alloc_size, align);
+
+		REQUIRE(mem != nullptr);
+		REQUIRE(reinterpret_cast<uintptr_t>(mem) % align == 0);
+
+		memset(mem, 0x7F, alloc_size);
+		heap.free_aligned(mem, alloc_size, align);
+	}
+
+	// A small object aligned past a chunk still takes a whole chunk sized window, so no other
+	// mapping can share its chunk map entry.
+	{
+		constexpr size_t ChunkSize = 4 * 1024 * 1024;
+		auto heap_size = heap.size();
+		vector<void *> huge_ptrs;
+
+		for (int i = 0; i < 8; i++)
+		{
+			auto mem = heap.alloc_aligned(100, 2 * ChunkSize);
+
+			REQUIRE(mem != nullptr);
+			REQUIRE(reinterpret_cast<uintptr_t>(mem) % (2 * ChunkSize) == 0);
+
+			huge_ptrs.push_back(mem);
+			huge_ptrs.push_back(heap.alloc(ChunkSize + 4096));
+		}
+
+		REQUIRE(heap.size() - heap_size >= 8 * ChunkSize);
+
+		for (size_t i = 0; i < huge_ptrs.size(); i++)
+		{
+			if (i % 4 == 0)
+				heap.free_aligned(huge_ptrs[i], 100, 2 * ChunkSize);
+			else
+				SmallAlloc::Heap::free_global(huge_ptrs[i]);
+		}
+
+		REQUIRE(heap.size() == heap_size);
+	}
+
+	// Small over-aligned objects come out of cache line class slots instead of whole buddy pages.
+	SmallAlloc::Heap small_heap(AllocLimit);
+	ptrs.clear();
+
+	for (int i = 0; i < 4096; i++)
+	{
+		size_t align = i % 2 ? 128 : 256;
+		size_t alloc_size = 24 + i % 200;
+		auto mem = small_heap.alloc_aligned(alloc_size, align);
+
+		REQUIRE(mem != nullptr);
+		REQUIRE(reinterpret_cast<uintptr_t>(mem) % align == 0);
+
+		memset(mem, 0x7F, alloc_size);
+		ptrs.push_back({mem, alloc_size, align});
+	}
+
+	auto heap_size = small_heap.size();
+
+	REQUIRE(heap_size < 8 * 1024 * 1024);
+
+	// Both kinds of global free find the slot an aligned object sits in.
+	for (size_t i = 0; i < ptrs.size(); i++)
+	{
+		if (i % 2)
+			SmallAlloc::Heap::free_global(get<0>(ptrs[i]));
+		else
+			SmallAlloc::Heap::free_global(get<0>(ptrs[i]), get<1>(ptrs[i]), get<2>(ptrs[i]));
+	}
+
+	SmallAlloc::Heap::flush_remote();
+
+	for (auto &ptr : ptrs)
+		REQUIRE(small_heap.alloc_aligned(get<1>(ptr), get<2>(ptr)) != nullptr);
+
+	REQUIRE(small_heap.size() == heap_size);
+}
+
+TEST_CASE("HeapReallocTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t MaxAllocSize = 16 * 1024 * 1024;
+
+	std::random_device r;
+	std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+	random_gen rand_size(seed);
+	std::uniform_int_distribution<int> size_shift(3, 24);
+
+	SmallAlloc::Heap heap(AllocLimit);
+
+	auto mem = static_cast<unsigned char *>(heap.realloc(nullptr, 0, 40));
+	size_t mem_size = 40;
+
+	REQUIRE(mem != nullptr);
+	REQUIRE(heap.realloc(mem, 40, 35) == mem);
+	REQUIRE(heap.realloc(mem, 35, 37) == mem);
+
+	for (int i = 0; i < 256; i++)
+	{
+		size_t new_size = std::min<size_t>((1ULL << size_shift(rand_size)) + rand_size() % 4096,
+										   MaxAllocSize);
+
+		for (size_t j = 0; j < std::min(mem_size, new_size); j += 509)
+			mem[j] = static_cast<unsigned char>(j + i);
+
+		auto new_mem = static_cast<unsigned char *>(heap.realloc(mem, mem_size, new_size));
+
+		REQUIRE(new_mem != nullptr);
+
+		for (size_t j = 0; j < std::min(mem_size, new_size); j += 509)
+			REQUIRE(new_mem[j] == static_cast<unsigned char>(j + i));
+
+		mem = new_mem;
+		mem_size = new_size;
+	}
+
+	heap.free(mem, mem_size);
+
+	SmallAlloc::Heap fresh_heap(AllocLimit);
+
+	auto big = fresh_heap.alloc(64 * 1024);
+	auto blocker = fresh_heap.alloc(64 * 1024);
+
+	REQUIRE(big != nullptr);
+	REQUIRE(blocker != nullptr);
+
+	fresh_heap.free(blocker, 64 * 1024);
+
+	REQUIRE(fresh_heap.realloc(big, 64 * 1024, 128 * 1024) == big);
+
+	fresh_heap.free(big, 128 * 1024);
+
+	// Resizing to 0 frees the block and hands out nothing.
+	auto small = fresh_heap.alloc(40);
+
+	REQUIRE(small != nullptr);
+	REQUIRE(fresh_heap.realloc(small, 40, 0) == nullptr);
+	REQUIRE(fresh_heap.realloc(nullptr, 0, 0) == nullptr);
+}
+
+TEST_CASE("HeapCallocTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t AllocSizes[] = {8, 24, 200, 4000, 8144, 12 * 1024, 1024 * 1024, 6 * 1024 * 1024};
+
+	SmallAlloc::Heap heap(AllocLimit);
+
+	REQUIRE(heap.calloc(SIZE_MAX / 2, 4) == nullptr);
+
+	auto is_zero = [](void *mem, size_t size)
+	{
+		auto bytes = static_cast<unsigned char *>(mem);
+		return std::all_of(bytes, bytes + size, [](auto byte)
+		{
+			return byte == 0;
+		});
+	};
+
+	for (int round = 0; round < 4; round++)
+	{
+		vector<pair<void *, size_t>> ptrs;
+
+		for (auto alloc_size : AllocSizes)
+		{
+			for (int i = 0; i < 64; i++)
+			{
+				auto mem = heap.calloc(1, alloc_size);
+
+				REQUIRE(mem != nullptr);
+				REQUIRE(is_zero(mem, alloc_size));
+
+				memset(mem, 0x7F, alloc_size);
+				ptrs.push_back({mem, alloc_size});
+			}
+		}
+
+		for (size_t i = 0; i < ptrs.size(); i += 2)
+			heap.free(ptrs[i].first, ptrs[i].second);
+
+		for (size_t i = 0; i < ptrs.size(); i += 2)
+		{
+			auto mem = heap.calloc(ptrs[i].second, 1);
+
+			REQUIRE(mem != nullptr);
+			REQUIRE(is_zero(mem, ptrs[i].second));
+
+			memset(mem, 0x7F, ptrs[i].second);
+			ptrs[i].first = mem;
+		}
+
+		for (auto &ptr : ptrs)
+			heap.free(ptr.first, ptr.second);
+	}
+}
+
+TEST_CASE("HeapFreeGlobalTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocSizes[] = {8, 100, 4000, 8144, 20 * 1024, 1024 * 1024, 5 * 1024 * 1024};
+	constexpr size_t Alignments[] = {1, 16, 64, 4096};
+	constexpr int Rounds = 8;
+
+	vector<tuple<void *, size_t, size_t>> ptrs;
+	auto &heap = SmallAlloc::Heap::thread_heap();
+
+	for (int round = 0; round < Rounds; round++)
+	{
+		for (auto alloc_size : AllocSizes)
+		{
+			for (auto align : Alignments)
+			{
+				auto mem = align == 1 ? heap.alloc(alloc_size) : heap.alloc_aligned(alloc_size, align);
+
+				REQUIRE(mem != nullptr);
+				memset(mem, 0x7F, alloc_size);
+				ptrs.push_back({mem, alloc_size, align});
+			}
+		}
+
+		thread([&ptrs]()
+		{
+			for (size_t i = 0; i < ptrs.size(); i++)
+			{
+				if (i % 2)
+					SmallAlloc::Heap::free_global(get<0>(ptrs[i]));
+				else
+					SmallAlloc::Heap::free_global(get<0>(ptrs[i]), get<1>(ptrs[i]), get<2>(ptrs[i]));
+			}
+
+			SmallAlloc::Heap::flush_remote();
+		}).join();
+
+		ptrs.clear();
+
+		for (auto alloc_size : AllocSizes)
+		{
+			auto mem = heap.alloc(alloc_size);
+
+			REQUIRE(mem != nullptr);
+
+			if (alloc_size % 2)
+				SmallAlloc::Heap::free_global(mem);
+			else
+				SmallAlloc::Heap::free_global(mem, alloc_size);
+		}
+	}
+}
+
+TEST_CASE("ArenaTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr int Requests = 4;
+	constexpr int TempsPerRequest = 16 * 1024;
+
+	struct Temp
+	{
+		Temp *next;
+		int value;
+	};
+
+	SmallAlloc::Heap heap(AllocLimit);
+	SmallAlloc::Arena arena(heap);
+	random_device r;
+	seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+	random_gen rand_op(seed);
+	uniform_int_distribution<size_t> size_dist(1, 512);
+
+	size_t retained_size = 0;
+
+	for (int request = 0; request < Requests; request++)
+	{
+		Temp *head = nullptr;
+
+		for (int i = 0; i < TempsPerRequest; i++)
+		{
+			auto size = size_dist(rand_op);
+			auto align = size_t{1} << (size % 7);
+			auto mem = arena.alloc(size, align);
+
+			REQUIRE(mem != nullptr);
+			REQUIRE(reinterpret_cast<uintptr_t>(mem) % align == 0);
+			memset(mem, 0x7F, size);
+
+			head = arena.make<Temp>(Temp{head, i});
+		}
+
+		// Oversized and over aligned requests go to the parent heap.
+		auto large = arena.alloc(3 * 1024 * 1024);
+		auto aligned = arena.alloc(1024, 128 * 1024);
+
+		REQUIRE(large != nullptr);
+		REQUIRE(reinterpret_cast<uintptr_t>(aligned) % (128 * 1024) == 0);
+		memset(large, 0x7F, 3 * 1024 * 1024);
+
+		for (int i = TempsPerRequest - 1; i >= 0; i--, head = head->next)
+			REQUIRE(head->value == i);
+
+		REQUIRE(arena.size() > 3 * 1024 * 1024);
+		arena.reset();
+		REQUIRE(arena.size() == 0);
+
+		// Every request hands all of its memory back to the heap.
+		if (request == 0)
+			retained_size = heap.size();
+
+		REQUIRE(heap.size() <= retained_size);
+	}
+
+	REQUIRE(arena.alloc(16, 3) == nullptr);
+}
+
+TEST_CASE("HeapResetTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t AllocSizes[] = {8, 100, 4000, 8144, 20 * 1024, 1024 * 1024, 5 * 1024 * 1024};
+	constexpr int Batches = 4;
+	constexpr int AllocsPerSize = 64;
+
+	SmallAlloc::Heap heap(AllocLimit);
+	size_t retained_size = 0;
+
+	for (int batch = 0; batch < Batches; batch++)
+	{
+		for (auto alloc_size : AllocSizes)
+		{
+			for (int i = 0; i < AllocsPerSize; i++)
+			{
+				auto mem = static_cast<char *>(heap.calloc(1, alloc_size));
+
+				REQUIRE(mem != nullptr);
+				REQUIRE(all_of(mem, mem + alloc_size, [](char c) { return c == 0; }));
+				memset(mem, 0x7F, alloc_size);
+			}
+		}
+
+		heap.reset();
+
+		// Retained chunks are reused, so recycling the heap does not grow it.
+		if (batch == 0)
+			retained_size = heap.size();
+
+		REQUIRE(heap.size() == retained_size);
+	}
+
+	heap.reset(false);
+	REQUIRE(heap.size() == 0);
+
+	auto mem = heap.alloc(64);
+
+	REQUIRE(mem != nullptr);
+	heap.free(mem, 64);
+}
+
+TEST_CASE("HeapReserveTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t BlockSize = 64 * 1024;
+	constexpr int BlockCount = 128;
+	constexpr size_t PageCount = BlockSize * BlockCount / 4096;
+	constexpr size_t ObjectSize = 64;
+	constexpr int ObjectCount = 16 * 1024;
+
+	SmallAlloc::Heap heap(AllocLimit);
+	vector<void *> blocks, objects;
+
+	REQUIRE(heap.reserve(ObjectSize, ObjectCount));
+	REQUIRE(heap.reserve(BlockSize, BlockCount));
+	REQUIRE(!heap.reserve(8 * 1024 * 1024, 1));
+
+	auto reserved_size = heap.size();
+
+	REQUIRE(reserved_size >= BlockSize * BlockCount + ObjectSize * ObjectCount);
+
+	// Reserving again reuses what is already there instead of growing the heap.
+	REQUIRE(heap.reserve(ObjectSize, ObjectCount));
+	REQUIRE(heap.reserve(BlockSize, BlockCount));
+	REQUIRE(heap.reserve_bytes(BlockSize * BlockCount));
+	REQUIRE(heap.size() == reserved_size);
+
+#ifndef _WIN32
+	auto minor_faults = []()
+	{
+		rusage usage;
+
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<size_t>(usage.ru_minflt);
+	};
+	auto faults_before = minor_faults();
+#endif // _WIN32
+
+	for (int i = 0; i < BlockCount; i++)
+	{
+		auto mem = heap.alloc(BlockSize);
+
+		REQUIRE(mem != nullptr);
+		memset(mem, 0x7F, BlockSize);
+		blocks.push_back(mem);
+	}
+
+#ifndef _WIN32
+	// Pages of reserved chunks were faulted in by reserve(), not by first use.
+	REQUIRE(minor_faults() - faults_before < PageCount / 4);
+#endif // _WIN32
+
+	REQUIRE(heap.size() == reserved_size);
+
+	// Slab pages were carved by reserve(), so the objects need no new pages either.
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		auto mem = heap.alloc(ObjectSize);
+
+		REQUIRE(mem != nullptr);
+		objects.push_back(mem);
+	}
+
+	REQUIRE(heap.size() == reserved_size);
+
+	for (auto mem : blocks)
+		heap.free(mem, BlockSize);
+
+	for (auto mem : objects)
+		heap.free(mem, ObjectSize);
+
+	REQUIRE(heap.size() == reserved_size);
+}
+
+TEST_CASE("HeapFixedBufferTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t ChunkSize = 4 * 1024 * 1024;
+	constexpr size_t BufferSize = 3 * ChunkSize;
+	constexpr size_t AllocSizes[] = {24, 1000, 8144, 64 * 1024};
+
+	// Offset the range so its first chunk is partial and must be skipped.
+	auto buffer = static_cast<char *>(aligned_alloc(ChunkSize, BufferSize));
+	auto memory = buffer + 4096;
+	auto memory_size = BufferSize - 4096;
+
+	{
+		SmallAlloc::Heap heap(memory, memory_size);
+		vector<pair<void *, size_t>> ptrs;
+		bool in_range = true;
+
+		REQUIRE(heap.size() >= ChunkSize);
+		REQUIRE(heap.alloc(ChunkSize + 1) == nullptr);
+
+		auto initial_size = heap.size();
+		auto fill = [&]()
+		{
+			for (auto alloc_size : AllocSizes)
+			{
+				void *mem;
+
+				while ((mem = heap.alloc(alloc_size)))
+				{
+					in_range &= mem >= memory && static_cast<char *>(mem) + alloc_size <= memory + memory_size;
+					memset(mem, 0x7F, alloc_size);
+					ptrs.push_back({mem, alloc_size});
+				}
+			}
+		};
+
+		fill();
+
+		auto alloc_count = ptrs.size();
+
+		REQUIRE(in_range);
+		REQUIRE(heap.size() == initial_size);
+		REQUIRE(alloc_count > ChunkSize / 8144);
+
+		for (auto ptr : ptrs)
+			heap.free(ptr.first, ptr.second);
+
+		ptrs.clear();
+		heap.reset();
+		fill();
+
+		REQUIRE(in_range);
+		REQUIRE(ptrs.size() == alloc_count);
+
+		heap.reset(false);
+
+		// Both whole chunks of the range can be handed out again, and nothing beyond them.
+		auto first = static_cast<char *>(heap.alloc(ChunkSize));
+		auto second = static_cast<char *>(heap.alloc(ChunkSize));
+
+		REQUIRE(first != nullptr);
+		REQUIRE(second != nullptr);
+		REQUIRE(first != second);
+		REQUIRE((first >= memory && first + ChunkSize <= memory + memory_size));
+		REQUIRE((second >= memory && second + ChunkSize <= memory + memory_size));
+		REQUIRE(heap.alloc(ChunkSize) == nullptr);
+	}
+
+	// A missing range leaves an empty heap rather than one backed by the system.
+	{
+		SmallAlloc::Heap heap(nullptr, BufferSize);
+
+		REQUIRE(heap.alloc(24) == nullptr);
+		REQUIRE(heap.alloc(64 * 1024) == nullptr);
+		REQUIRE(heap.alloc(ChunkSize + 1) == nullptr);
+		REQUIRE(heap.size() == 0);
+	}
+
+	free(buffer);
+}
+
+#ifndef _WIN32
+TEST_CASE("HeapLockedTest", "[allocator]")
+{
+	using namespace std;
+
+	constexpr size_t AllocLimit = 64LL * 1024 * 1024 * 1024;
+	constexpr size_t AllocSizes[] = {16, 256, 4000, 64 * 1024};
+	constexpr int AllocsPerSize = 128;
+	constexpr int Rounds = 16;
+
+	SmallAlloc::Heap heap(AllocLimit, SmallAlloc::Heap::LOCKED);
+	vector<void *> ptrs(std::size(AllocSizes) * AllocsPerSize);
+	size_t failed_allocs = 0;
+
+	auto minor_faults = []()
+	{
+		rusage usage;
+
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<size_t>(usage.ru_minflt);
+	};
+	auto run_round = [&]()
+	{
+		size_t i = 0;
+
+		for (auto alloc_size : AllocSizes)
+		{
+			for (int n = 0; n < AllocsPerSize; n++, i++)
+			{
+				ptrs[i] = heap.alloc(alloc_size);
+
+				if (ptrs[i])
+					memset(ptrs[i], 0x7F, alloc_size);
+				else
+					failed_allocs++;
+			}
+		}
+
+		i = 0;
+
+		for (auto alloc_size : AllocSizes)
+		{
+			for (int n = 0; n < AllocsPerSize; n++, i++)
+				heap.free(ptrs[i], alloc_size);
+		}
+	};
+
+	// The first round maps and locks the chunks; later rounds reuse them and never fault.
+	run_round();
+
+	auto faults_before = minor_faults();
+
+	for (int round = 0; round < Rounds; round++)
+		run_round();
+
+	auto faults = minor_faults() - faults_before;
+
+	REQUIRE(failed_allocs == 0);
+
+	// AddressSanitizer faults in its own bookkeeping pages along the way.
+#ifndef __SANITIZE_ADDRESS__
+	REQUIRE(faults == 0);
+#else
+	(void) faults;
+#endif // __SANITIZE_ADDRESS__
+
+	// Chunks stay with a locked heap across a full reset.
+	auto heap_size = heap.size();
+
+	heap.reset(false);
+
+	REQUIRE(heap.size() == heap_size);
+}
+#endif // _WIN32
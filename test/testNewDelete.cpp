@@ -0,0 +1,78 @@
+/**
+ * File: /testNewDelete.cpp
+ * Project: test
+ * Created Date: Monday, October 19th 2026, 11:48:26 pm
+ * Author: Harikrishnan
+ */
+
+
+#include "Heap.h"
+#include "test/catch.hpp"
+
+#include <list>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("NewDeleteTest", "[allocator]")
+{
+	using namespace std;
+	using SmallAlloc::Heap;
+
+	struct alignas(64) CacheLine
+	{
+		char data[64];
+	};
+
+	struct alignas(4096) Page
+	{
+		char data[4096];
+	};
+
+	auto &heap = Heap::thread_heap();
+	auto heap_size = heap.size();
+	vector<unique_ptr<string>> strings;
+
+	// Global new is served by the thread's heap.
+	for (int i = 0; i < 64 * 1024; i++)
+		strings.push_back(make_unique<string>(40 + i % 200, 'x'));
+
+	REQUIRE(heap.size() > heap_size);
+
+	for (size_t size = 1; size <= 1024; size++)
+	{
+		auto ptr = operator new(size);
+
+		REQUIRE(reinterpret_cast<uintptr_t>(ptr) % min<size_t>(__STDCPP_DEFAULT_NEW_ALIGNMENT__, size & (0 - size)) == 0);
+		memset(ptr, 0x7F, size);
+
+		if (size % 2)
+			operator delete(ptr);
+		else
+			operator delete(ptr, size);
+	}
+
+	auto cache_lines = make_unique<CacheLine[]>(100);
+	auto page = make_unique<Page>();
+	auto numbers = new (nothrow) int[1000];
+
+	REQUIRE(reinterpret_cast<uintptr_t>(cache_lines.get()) % alignof(CacheLine) == 0);
+	REQUIRE(reinterpret_cast<uintptr_t>(page.get()) % alignof(Page) == 0);
+	REQUIRE(numbers != nullptr);
+
+	delete[] numbers;
+
+	// Objects freed by another thread return to the heap that owns them.
+	list<string> moved;
+
+	thread([&]()
+	{
+		for (int i = 0; i < 4096; i++)
+			moved.emplace_back(100, 'y');
+	}).join();
+
+	moved.clear();
+	strings.clear();
+}
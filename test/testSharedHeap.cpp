@@ -0,0 +1,252 @@
+/**
+ * File: /testSharedHeap.cpp
+ * Project: test
+ * Created Date: Monday, October 19th 2026, 10:41:09 pm
+ * Author: Harikrishnan
+ */
+
+
+#include "PersistentHeap.h"
+#include "SharedHeap.h"
+#include "test/catch.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
+
+TEST_CASE("SharedHeapTest", "[allocator]")
+{
+	using namespace std;
+	using SmallAlloc::SharedHeap;
+
+	constexpr size_t MappingSize = 3 * 4 * 1024 * 1024;
+	constexpr size_t MessageSizes[] = {24, 200, 2048, 6000, 64 * 1024, 1024 * 1024};
+	constexpr int Rounds = 64;
+	constexpr int MessagesPerRound = 24;
+
+	struct Message
+	{
+		SharedHeap::Offset offset;
+		size_t size;
+	};
+
+	auto fd = memfd_create("SharedHeapTest", 0);
+
+	REQUIRE(fd >= 0);
+	REQUIRE(ftruncate(fd, MappingSize) == 0);
+
+	// Two mappings of the same memory stand in for the producer and consumer processes.
+	auto producer_mapping = mmap(nullptr, MappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	auto consumer_mapping = mmap(nullptr, MappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	REQUIRE(producer_mapping != MAP_FAILED);
+	REQUIRE(consumer_mapping != MAP_FAILED);
+	REQUIRE(!SharedHeap(consumer_mapping).is_valid());
+
+	SharedHeap producer(producer_mapping, MappingSize);
+	SharedHeap consumer(consumer_mapping);
+
+	REQUIRE(producer.is_valid());
+	REQUIRE(consumer.is_valid());
+	REQUIRE(producer.capacity() == 2 * 4 * 1024 * 1024);
+	REQUIRE(producer.alloc(4 * 1024 * 1024 + 1) == nullptr);
+
+	vector<Message> queue(MessagesPerRound);
+	atomic<int> published{0}, consumed{0};
+	size_t failed_allocs = 0, corrupt_messages = 0;
+
+	thread consumer_thread([&]()
+	{
+		for (int round = 0; round < Rounds; round++)
+		{
+			while (published.load(memory_order_acquire) == round)
+				this_thread::yield();
+
+			for (auto &message : queue)
+			{
+				auto data = static_cast<unsigned char *>(consumer.from_offset(message.offset));
+
+				if (data[0] != message.size % 251 || data[message.size - 1] != message.size % 251)
+					corrupt_messages++;
+
+				consumer.remote_free(data, message.size);
+			}
+
+			consumed.store(round + 1, memory_order_release);
+		}
+	});
+
+	// All rounds together publish far more than the heap holds, so remotely freed buffers must be reused.
+	for (int round = 0; round < Rounds; round++)
+	{
+		while (consumed.load(memory_order_acquire) != round)
+			this_thread::yield();
+
+		for (int i = 0; i < MessagesPerRound; i++)
+		{
+			auto size = MessageSizes[(round + i) % std::size(MessageSizes)];
+			auto data = producer.alloc(size);
+
+			if (!data)
+			{
+				failed_allocs++;
+				size = MessageSizes[0];
+				data = producer.alloc(size);
+			}
+
+			memset(data, size % 251, size);
+			queue[i] = {producer.to_offset(data), size};
+		}
+
+		published.store(round + 1, memory_order_release);
+	}
+
+	consumer_thread.join();
+
+	REQUIRE(failed_allocs == 0);
+	REQUIRE(corrupt_messages == 0);
+
+	// Once everything is back, a whole chunk can be handed out as one block again.
+	REQUIRE(producer.alloc(4 * 1024 * 1024) != nullptr);
+
+	munmap(producer_mapping, MappingSize);
+	munmap(consumer_mapping, MappingSize);
+	close(fd);
+}
+
+TEST_CASE("PersistentHeapTest", "[allocator]")
+{
+	using namespace std;
+	using SmallAlloc::PersistentHeap;
+	using SmallAlloc::SharedHeap;
+
+	constexpr size_t HeapSize = 3 * 4 * 1024 * 1024;
+	constexpr size_t NodeSizes[] = {32, 100, 1500, 5000, 20000};
+	constexpr int NumNodes = 600;
+
+	struct Node
+	{
+		SharedHeap::Offset next;
+		size_t size;
+	};
+
+	auto node_size = [&](int i) { return NodeSizes[i % std::size(NodeSizes)]; };
+
+	auto count_nodes = [](SharedHeap &heap)
+	{
+		int count = 0;
+
+		for (auto node = static_cast<Node *>(heap.get_root()); node;
+			 node = node->next ? static_cast<Node *>(heap.from_offset(node->next)) : nullptr)
+		{
+			auto data = reinterpret_cast<unsigned char *>(node + 1);
+
+			if (data[0] != node->size % 251 || data[node->size - sizeof(Node) - 1] != node->size % 251)
+				return -1;
+
+			count++;
+		}
+
+		return count;
+	};
+
+	// Counts every free buddy page, which only matches across a restart if recovery found them all.
+	auto count_free_pages = [](SharedHeap &heap)
+	{
+		vector<void *> pages;
+
+		while (auto page = heap.alloc(4096))
+			pages.push_back(page);
+
+		for (auto page : pages)
+			heap.free(page, 4096);
+
+		return pages.size();
+	};
+
+	char path[] = "/tmp/PersistentHeapTestXXXXXX";
+	auto fd = mkstemp(path);
+
+	REQUIRE(fd >= 0);
+	close(fd);
+
+	int live_nodes = 0;
+	size_t free_pages = 0;
+	void *old_base;
+
+	{
+		PersistentHeap heap(path, HeapSize);
+		Node *head = nullptr;
+
+		REQUIRE(heap.is_valid());
+		REQUIRE(heap.created());
+		REQUIRE(!PersistentHeap(path, HeapSize).is_valid());
+
+		for (int i = 0; i < NumNodes; i++)
+		{
+			auto size = node_size(i);
+			auto node = static_cast<Node *>(heap.alloc(size));
+
+			REQUIRE(node != nullptr);
+
+			// Leave holes behind, some of them still queued on the remote free lists.
+			if (i % 3 == 0)
+			{
+				if (i % 2)
+					heap.free(node, size);
+				else
+					heap.remote_free(node, size);
+
+				continue;
+			}
+
+			node->next = head ? heap.to_offset(head) : 0;
+			node->size = size;
+			memset(node + 1, size % 251, size - sizeof(Node));
+			head = node;
+			live_nodes++;
+		}
+
+		heap.set_root(head);
+		free_pages = count_free_pages(heap);
+		old_base = heap.from_offset(0);
+
+		REQUIRE(heap.flush());
+	}
+
+	// Keep the old address range busy so the heap has to be reopened somewhere else.
+	auto placeholder = mmap(old_base, HeapSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	REQUIRE(placeholder != MAP_FAILED);
+
+	{
+		PersistentHeap heap(path, 0);
+
+		REQUIRE(heap.is_valid());
+		REQUIRE(!heap.created());
+		REQUIRE(heap.from_offset(0) != old_base);
+		REQUIRE(count_nodes(heap) == live_nodes);
+		REQUIRE(count_free_pages(heap) == free_pages);
+
+		for (int i = 0; i < NumNodes / 2; i++)
+		{
+			auto size = node_size(i);
+			auto ptr = heap.alloc(size);
+
+			REQUIRE(ptr != nullptr);
+			memset(ptr, 0xEE, size);
+		}
+
+		REQUIRE(count_nodes(heap) == live_nodes);
+	}
+
+	munmap(placeholder, HeapSize);
+	unlink(path);
+}
+#endif // _WIN32
@@ -1,6 +1,8 @@
 
 #include "BuddyManager/BuddyManager.h"
 #include "SlabAllocator.h"
+#include "SlabSizeClass.h"
+#include "SlabPageCache.h"
 #include "test/catch.hpp"
 #include "test/testBase.h"
 
@@ -8,6 +10,7 @@
 #include <random>
 #include <iostream>
 #include <unordered_set>
+#include <vector>
 
 using random_gen = std::ranlux24_base;
 
@@ -132,4 +135,156 @@ TEST_CASE("SlabAllocatorTest", "[allocator]")
 
 	REQUIRE(dummy.alloc() == nullptr);
 	REQUIRE(dummy.size() == 0);
-}
\ No newline at end of file
+}
+
+TEST_CASE("SlabObjectCacheTest", "[allocator]")
+{
+	using namespace std;
+	using Size = SmallAlloc::Size;
+	using Count = SmallAlloc::Count;
+	using namespace SmallAlloc::SlabAllocator;
+
+	struct CachedObject
+	{
+		uint64_t magic;
+		uint64_t uses;
+		uint64_t payload[3];
+	};
+
+	constexpr uint64_t Constructed = 0xC0FFEE;
+	constexpr uint32_t SlabPageSize = 4 * 1024;
+	constexpr size_t ObjectCount = 1024;
+
+	Count constructed = 0, destructed = 0;
+	vector<CachedObject *> objects;
+
+	{
+		SlabAllocator slab{sizeof(CachedObject), SlabPageSize, [](Size align, Size size)
+		{
+			return aligned_alloc(align, size);
+		}, [](void *page, Size)
+		{
+			free(page);
+		}, [&constructed](void *obj)
+		{
+			new (obj) CachedObject{Constructed, 0, {}};
+			constructed++;
+		}, [&](void *obj)
+		{
+			REQUIRE(static_cast<CachedObject *>(obj)->magic == Constructed);
+			destructed++;
+		}};
+
+		// Fill every populated slot, so later allocations can only reuse freed objects.
+		while (objects.size() < ObjectCount || objects.size() < constructed)
+		{
+			auto obj = static_cast<CachedObject *>(slab.alloc());
+
+			REQUIRE(obj != nullptr);
+			REQUIRE(obj->magic == Constructed);
+			REQUIRE(obj->uses == 0);
+			obj->uses++;
+			objects.push_back(obj);
+		}
+
+		auto populated = constructed;
+		auto per_page = populated / (slab.size() / SlabPageSize);
+
+		REQUIRE(populated >= ObjectCount);
+		REQUIRE(per_page * (slab.size() / SlabPageSize) == populated);
+
+		for (size_t i = 1; i < objects.size(); i += 2)
+		{
+			if (i % 4 == 1)
+				slab.free(objects[i]);
+			else
+				slab.remote_free(objects[i]);
+		}
+
+		slab.reclaim_remote_free();
+
+		// Freed objects come back constructed, with the state they were freed in.
+		for (size_t i = 1; i < objects.size(); i += 2)
+		{
+			auto obj = objects[i] = static_cast<CachedObject *>(slab.alloc());
+
+			REQUIRE(obj->magic == Constructed);
+			REQUIRE(obj->uses == 1);
+		}
+
+		REQUIRE(constructed == populated);
+		REQUIRE(destructed == 0);
+
+		for (auto obj : objects)
+			slab.free(obj);
+
+		REQUIRE(slab.size() == SlabPageSize);
+		REQUIRE(destructed == populated - per_page);
+	}
+
+	REQUIRE(destructed == constructed);
+}
+
+TEST_CASE("SlabSizeClassTest", "[allocator]")
+{
+	using namespace SmallAlloc;
+
+	for (SizeClass szc = 0; szc < NUM_SIZE_CLASSES; szc++)
+	{
+		auto alloc_size = sizeclass_to_allocsize[szc];
+		auto reciprocal = SlabAllocator::SlabAllocator::reciprocal_of(alloc_size);
+		bool index_is_exact = true;
+
+		for (uint64_t offset = 0; offset < sizeclass_to_pagesize[szc]; offset++)
+			index_is_exact &= ((offset * reciprocal) >> 32) == offset / alloc_size;
+
+		REQUIRE(index_is_exact);
+	}
+
+	for (SizeClass szc = 0; szc < NUM_CACHELINE_SIZE_CLASSES; szc++)
+	{
+		auto alloc_size = cacheline_sizeclass_to_allocsize[szc];
+		auto reciprocal = SlabAllocator::SlabAllocator::reciprocal_of(alloc_size);
+		bool index_is_exact = true;
+
+		for (uint64_t offset = 0; offset < cacheline_sizeclass_to_pagesize[szc]; offset++)
+			index_is_exact &= ((offset * reciprocal) >> 32) == offset / alloc_size;
+
+		REQUIRE(index_is_exact);
+	}
+}
+
+TEST_CASE("SlabPageCacheTest", "[allocator]")
+{
+	using namespace std;
+	using namespace SmallAlloc;
+
+	constexpr auto PageSize = SlabPageCache::MIN_PAGE_SIZE * 4;
+	constexpr auto NumCachedPages = SlabPageCache::MAX_CACHED_BYTES / PageSize;
+
+	SlabPageCache cache;
+	vector<void *> pages;
+
+	for (Count i = 0; i <= NumCachedPages; i++)
+		pages.push_back(aligned_alloc(PageSize, PageSize));
+
+	REQUIRE(cache.get(PageSize) == nullptr);
+
+	for (Count i = 0; i < NumCachedPages; i++)
+		REQUIRE(cache.put(pages[i], PageSize));
+
+	REQUIRE(!cache.put(pages[NumCachedPages], PageSize));
+	REQUIRE(cache.get(SlabPageCache::MIN_PAGE_SIZE) == nullptr);
+
+	unordered_set<void *> cached;
+
+	for (Count i = 0; i < NumCachedPages; i++)
+		cached.insert(cache.get(PageSize));
+
+	REQUIRE(cache.get(PageSize) == nullptr);
+	REQUIRE(cached.size() == NumCachedPages);
+	REQUIRE(cached.count(nullptr) == 0);
+
+	for (auto page : pages)
+		free(page);
+}
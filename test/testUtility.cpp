@@ -205,6 +205,15 @@ TEST_CASE("FreelistAtomic Test", "[utility]")
 	REQUIRE(static_cast<FLNode *>(fl.pop())->val == 4);
 	REQUIRE(fl.empty() == true);
 
+	fl.push(&n1);
+	n5.next = &n4;
+	fl.push(&n5, &n4);
+
+	REQUIRE(static_cast<FLNode *>(fl.pop())->val == 5);
+	REQUIRE(static_cast<FLNode *>(fl.pop())->val == 4);
+	REQUIRE(static_cast<FLNode *>(fl.pop())->val == 1);
+	REQUIRE(fl.empty() == true);
+
 	constexpr int MAX_THREADS = 8;
 	std::vector<std::thread> workers;
 	std::atomic_bool quit(0);